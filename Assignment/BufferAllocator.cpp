@@ -0,0 +1,76 @@
+#include <stdexcept>
+
+#include "BufferAllocator.h"
+
+BufferAllocator::BufferAllocator(const std::size_t capacity) : _capacity{ capacity }, _freeSize{ capacity } {
+	if (capacity > 0) {
+		_freeRanges.emplace(0, capacity);
+	}
+}
+
+std::optional<std::size_t> BufferAllocator::allocate(const std::size_t size, const std::size_t alignment) {
+	if (size == 0) {
+		return 0;
+	}
+
+	for (auto it = _freeRanges.begin(); it != _freeRanges.end(); ++it) {
+		const auto [offset, rangeSize] = *it;
+		const auto aligned = (offset + alignment - 1) / alignment * alignment;
+		if (aligned + size > offset + rangeSize) {
+			continue;
+		}
+
+		// carve the allocation out, keeping what is left on both sides
+		_freeRanges.erase(it);
+		if (aligned > offset) {
+			_freeRanges.emplace(offset, aligned - offset);
+		}
+		if (aligned + size < offset + rangeSize) {
+			_freeRanges.emplace(aligned + size, offset + rangeSize - aligned - size);
+		}
+		_freeSize -= size;
+		return aligned;
+	}
+
+	return std::nullopt;
+}
+
+void BufferAllocator::free(const std::size_t offset, const std::size_t size) {
+	if (size == 0) {
+		return;
+	}
+	if (offset + size > _capacity) {
+		throw std::invalid_argument("Freed range is out of the allocator capacity.");
+	}
+
+	auto start = offset;
+	auto end = offset + size;
+
+	// merge with the free range right after
+	const auto next = _freeRanges.lower_bound(offset);
+	if (next != _freeRanges.end() && next->first == end) {
+		end += next->second;
+		_freeRanges.erase(next);
+	}
+
+	// merge with the free range right before
+	auto previous = _freeRanges.lower_bound(offset);
+	if (previous != _freeRanges.begin()) {
+		--previous;
+		if (previous->first + previous->second == start) {
+			start = previous->first;
+			_freeRanges.erase(previous);
+		}
+	}
+
+	_freeRanges.emplace(start, end - start);
+	_freeSize += size;
+}
+
+std::size_t BufferAllocator::getCapacity() const {
+	return _capacity;
+}
+
+std::size_t BufferAllocator::getFreeSize() const {
+	return _freeSize;
+}
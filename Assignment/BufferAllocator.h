@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <optional>
+
+// Hands out ranges of a fixed capacity, in whatever unit the owner picks. Free ranges are kept
+// sorted by offset so releasing a range coalesces it with its neighbors.
+class BufferAllocator {
+public:
+	explicit BufferAllocator(std::size_t capacity);
+
+	// First fit, the returned offset is a multiple of the alignment.
+	[[nodiscard]] std::optional<std::size_t> allocate(std::size_t size, std::size_t alignment = 1);
+
+	void free(std::size_t offset, std::size_t size);
+
+	[[nodiscard]] std::size_t getCapacity() const;
+
+	[[nodiscard]] std::size_t getFreeSize() const;
+
+private:
+	std::size_t _capacity;
+
+	std::size_t _freeSize;
+
+	// offset -> size of every free range
+	std::map<std::size_t, std::size_t> _freeRanges{};
+};
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "BufferArena.h"
+
+GeometryAllocation BufferArena::allocate(
+	const std::vector<GenericAttribute>& layout,
+	const std::size_t vertexCount,
+	const std::size_t indexBytes
+) {
+	const auto tryPage = [&](const std::size_t index, Page& page) -> std::optional<GeometryAllocation> {
+		const auto baseVertex = page.vertices.allocate(vertexCount);
+		if (!baseVertex) {
+			return std::nullopt;
+		}
+		const auto indexOffset = page.indices.allocate(indexBytes, INDEX_ALIGNMENT);
+		if (!indexOffset) {
+			page.vertices.free(*baseVertex, vertexCount);
+			return std::nullopt;
+		}
+		return GeometryAllocation{ index, *baseVertex, vertexCount, *indexOffset, indexBytes };
+	};
+
+	for (std::size_t i = 0; i < _pages.size(); ++i) {
+		// indices alone take no room in the vertex buffer, so the format of the page does not matter
+		if (vertexCount != 0 && !sameLayout(_pages[i].layout, layout)) {
+			continue;
+		}
+		if (const auto allocation = tryPage(i, _pages[i])) {
+			return *allocation;
+		}
+	}
+
+	// No page of this format has room left, open a new one large enough for the mesh
+	auto& page = createPage(layout, vertexCount, indexBytes);
+	return *tryPage(_pages.size() - 1, page);
+}
+
+void BufferArena::upload(
+	const GeometryAllocation& allocation,
+	const std::span<const std::byte> vertices,
+	const std::span<const std::byte> indices
+) {
+	const auto& page = _pages.at(allocation.page);
+
+	// The copy target is not part of any VAO state, unlike the element array binding
+	glBindBuffer(GL_COPY_WRITE_BUFFER, page.vertexBuffer);
+	glBufferSubData(
+		GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(allocation.baseVertex * page.stride),
+		static_cast<GLsizeiptr>(vertices.size()), vertices.data()
+	);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, page.indexBuffer);
+	glBufferSubData(
+		GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(allocation.indexOffset),
+		static_cast<GLsizeiptr>(indices.size()), indices.data()
+	);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void BufferArena::upload(const GeometryAllocation& allocation, const Writer& writer) {
+	const auto& page = _pages.at(allocation.page);
+	const auto vertexBytes = allocation.vertexCount * page.stride;
+	const auto indexOffset = (vertexBytes + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+	const auto stagingBytes = std::max<std::size_t>(indexOffset + allocation.indexBytes, 1);
+
+	const auto stagingOffset = allocateStaging(stagingBytes);
+	const auto staging = _stagingRegion.subspan(stagingOffset, stagingBytes);
+	writer(staging.subspan(0, vertexBytes), staging.subspan(indexOffset, allocation.indexBytes));
+	const auto sourceOffset = _staging->getOffset() + stagingOffset;
+
+	glBindBuffer(GL_COPY_READ_BUFFER, _staging->getBuffer());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, page.vertexBuffer);
+	glCopyBufferSubData(
+		GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+		static_cast<GLintptr>(sourceOffset), static_cast<GLintptr>(allocation.baseVertex * page.stride),
+		static_cast<GLsizeiptr>(vertexBytes)
+	);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, page.indexBuffer);
+	glCopyBufferSubData(
+		GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+		static_cast<GLintptr>(sourceOffset + indexOffset), static_cast<GLintptr>(allocation.indexOffset),
+		static_cast<GLsizeiptr>(allocation.indexBytes)
+	);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+std::size_t BufferArena::allocateStaging(const std::size_t bytes) {
+	// Grow by replacing, a buffer still in use is only released once the GPU is done with it
+	if (!_staging || _staging->getRegionBytes() < bytes) {
+		_staging = std::make_unique<StreamBuffer>(std::max(bytes, STAGING_REGION_BYTES), STAGING_REGION_COUNT);
+		_stagingRegion = _staging->map();
+		_stagingHead = 0;
+	} else if (_stagingHead + bytes > _stagingRegion.size()) {
+		// only waits if the GPU has not copied out of the region since the ring last came around to it
+		_stagingRegion = _staging->map();
+		_stagingHead = 0;
+	}
+
+	const auto offset = _stagingHead;
+	_stagingHead = (offset + bytes + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+	return offset;
+}
+
+void BufferArena::download(
+	const GeometryAllocation& allocation,
+	const std::span<std::byte> vertices,
+	const std::span<std::byte> indices
+) const {
+	const auto& page = _pages.at(allocation.page);
+	if (vertices.size() != allocation.vertexCount * page.stride || indices.size() != allocation.indexBytes) {
+		throw std::invalid_argument("The download does not match the size of the allocation.");
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, page.vertexBuffer);
+	glGetBufferSubData(
+		GL_COPY_READ_BUFFER, static_cast<GLintptr>(allocation.baseVertex * page.stride),
+		static_cast<GLsizeiptr>(vertices.size()), vertices.data()
+	);
+	glBindBuffer(GL_COPY_READ_BUFFER, page.indexBuffer);
+	glGetBufferSubData(
+		GL_COPY_READ_BUFFER, static_cast<GLintptr>(allocation.indexOffset),
+		static_cast<GLsizeiptr>(indices.size()), indices.data()
+	);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+const std::vector<GenericAttribute>& BufferArena::getLayout(const GeometryAllocation& allocation) const {
+	return _pages.at(allocation.page).layout;
+}
+
+void BufferArena::free(const GeometryAllocation& allocation) {
+	auto& page = _pages.at(allocation.page);
+	page.vertices.free(allocation.baseVertex, allocation.vertexCount);
+	page.indices.free(allocation.indexOffset, allocation.indexBytes);
+}
+
+CommandAllocation BufferArena::allocateCommands(const std::span<const DrawElementsIndirectCommand> commands) {
+	auto allocation = std::optional<CommandAllocation>{};
+	for (std::size_t i = 0; i < _commandPages.size() && !allocation; ++i) {
+		if (const auto offset = _commandPages[i].commands.allocate(commands.size())) {
+			allocation = CommandAllocation{ i, *offset, commands.size() };
+		}
+	}
+
+	if (!allocation) {
+		const auto capacity = std::max(COMMAND_PAGE_COUNT, commands.size());
+		_commandPages.emplace_back(createBuffer(capacity * sizeof(DrawElementsIndirectCommand)), BufferAllocator{ capacity });
+		allocation = CommandAllocation{ _commandPages.size() - 1, *_commandPages.back().commands.allocate(commands.size()), commands.size() };
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _commandPages[allocation->page].buffer);
+	glBufferSubData(
+		GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(allocation->offset * sizeof(DrawElementsIndirectCommand)),
+		static_cast<GLsizeiptr>(commands.size_bytes()), commands.data()
+	);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	return *allocation;
+}
+
+void BufferArena::free(const CommandAllocation& allocation) {
+	_commandPages.at(allocation.page).commands.free(allocation.offset, allocation.count);
+}
+
+GLuint BufferArena::getVertexArray(const GeometryAllocation& allocation) const {
+	return _pages.at(allocation.page).vao;
+}
+
+GLuint BufferArena::getVertexBuffer(const GeometryAllocation& allocation) const {
+	return _pages.at(allocation.page).vertexBuffer;
+}
+
+GLuint BufferArena::getCommandBuffer(const CommandAllocation& allocation) const {
+	return _commandPages.at(allocation.page).buffer;
+}
+
+GLuint BufferArena::createVertexArray(const GeometryAllocation& allocation) const {
+	const auto& page = _pages.at(allocation.page);
+	return createVertexArray(page.layout, page.indexBuffer);
+}
+
+GLuint BufferArena::createVertexArray(const GeometryAllocation& allocation, const std::vector<GenericAttribute>& layout) const {
+	return createVertexArray(layout, _pages.at(allocation.page).indexBuffer);
+}
+
+void BufferArena::destroy() {
+	_staging.reset();
+	_stagingRegion = {};
+	_stagingHead = 0;
+
+	for (const auto& page : _pages) {
+		glDeleteVertexArrays(1, &page.vao);
+		glDeleteBuffers(1, &page.vertexBuffer);
+		glDeleteBuffers(1, &page.indexBuffer);
+	}
+	_pages.clear();
+
+	for (const auto& page : _commandPages) {
+		glDeleteBuffers(1, &page.buffer);
+	}
+	_commandPages.clear();
+}
+
+BufferArena::Page& BufferArena::createPage(
+	const std::vector<GenericAttribute>& layout,
+	const std::size_t vertexCount,
+	const std::size_t indexBytes
+) {
+	const auto stride = vertexStride(layout);
+	const auto vertexCapacity = std::max(VERTEX_PAGE_BYTES / stride, vertexCount);
+	const auto indexCapacity = std::max(INDEX_PAGE_BYTES, indexBytes);
+
+	const auto vertexBuffer = createBuffer(vertexCapacity * stride);
+	const auto indexBuffer = createBuffer(indexCapacity);
+
+	// A single VAO per page: the vertex format is described once and bound to the page buffers
+	const auto vao = createVertexArray(layout, indexBuffer);
+	glBindVertexArray(vao);
+	glBindVertexBuffer(0, vertexBuffer, 0, static_cast<GLsizei>(stride));
+	glBindVertexArray(0);
+
+	return _pages.emplace_back(
+		layout, stride, vao, vertexBuffer, indexBuffer,
+		BufferAllocator{ vertexCapacity }, BufferAllocator{ indexCapacity }
+	);
+}
+
+GLuint BufferArena::createVertexArray(const std::vector<GenericAttribute>& layout, const GLuint indexBuffer) {
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	std::size_t offset = 0;
+	for (unsigned int idx = 0; idx < layout.size(); ++idx) {
+		const auto [type, size, normalized] = getAttributeFormat(layout[idx]);
+		glVertexAttribFormat(idx, size, type, normalized, static_cast<GLuint>(offset));
+		glVertexAttribBinding(idx, 0);
+		glEnableVertexAttribArray(idx);
+		offset += attributeBytes(layout[idx]);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+	glBindVertexArray(0);
+	return vao;
+}
+
+GLuint BufferArena::createBuffer(const std::size_t size) {
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	// Immutable storage, only ever written through glBufferSubData
+	glBufferStorage(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return buffer;
+}
+
+bool BufferArena::sameLayout(const std::vector<GenericAttribute>& a, const std::vector<GenericAttribute>& b) {
+	return std::ranges::equal(a, b, [](const auto& x, const auto& y) {
+		return x.size == y.size && x.normalized == y.normalized && x.type == y.type;
+	});
+}
+
+BufferArena::AttributeFormat BufferArena::getAttributeFormat(const GenericAttribute& attribute) {
+	const auto size = static_cast<GLint>(attribute.size);
+	switch (attribute.type) {
+	case AttributeType::HALF_FLOAT:
+		return { GL_HALF_FLOAT, size, static_cast<GLboolean>(!attribute.normalized) };
+	case AttributeType::UNSIGNED_SHORT:
+		return { GL_UNSIGNED_SHORT, size, GL_TRUE };
+	case AttributeType::UNSIGNED_BYTE:
+		return { GL_UNSIGNED_BYTE, size, GL_TRUE };
+	case AttributeType::INT_2_10_10_10_REV:
+		// packed formats always fetch 4 components, the shader simply ignores w
+		return { GL_INT_2_10_10_10_REV, 4, GL_TRUE };
+	case AttributeType::FLOAT:
+	default:
+		return { GL_FLOAT, size, static_cast<GLboolean>(!attribute.normalized) };
+	}
+}
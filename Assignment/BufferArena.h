@@ -0,0 +1,126 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "BufferAllocator.h"
+#include "Mesh.h"
+#include "StreamBuffer.h"
+#include "drawable/Vertex.h"
+
+// Keeps the geometry of every loaded mesh in a handful of large immutable buffers. Each page holds
+// a vertex buffer of a single vertex format, an index buffer and the VAO tying both together, so
+// meshes sharing a format are drawn with base vertices and offsets instead of buffer rebinds.
+class BufferArena {
+public:
+	BufferArena() = default;
+	~BufferArena() = default;
+	BufferArena(const BufferArena&) = delete;
+	BufferArena(BufferArena&&) noexcept = delete;
+	BufferArena& operator=(const BufferArena&) = delete;
+	BufferArena& operator=(BufferArena&&) noexcept = delete;
+
+	// Reserves room for the vertices and indices of a mesh, in a page of the matching vertex format.
+	// Without vertices, the indices go to any page with room, the layout only picks the format of a page opened for them.
+	[[nodiscard]] GeometryAllocation allocate(
+		const std::vector<GenericAttribute>& layout,
+		std::size_t vertexCount,
+		std::size_t indexBytes
+	);
+
+	void upload(const GeometryAllocation& allocation, std::span<const std::byte> vertices, std::span<const std::byte> indices);
+
+	// Lets the writer fill the vertices and indices of an allocation in place, in mapped staging memory
+	// the GPU then copies into the page, so the mesh never needs a copy of its own in CPU memory.
+	using Writer = std::function<void(std::span<std::byte> vertices, std::span<std::byte> indices)>;
+	void upload(const GeometryAllocation& allocation, const Writer& writer);
+
+	void free(const GeometryAllocation& allocation);
+
+	// Reserves room for indirect commands and uploads them right away.
+	[[nodiscard]] CommandAllocation allocateCommands(std::span<const DrawElementsIndirectCommand> commands);
+
+	void free(const CommandAllocation& allocation);
+
+	// Reads the vertices and indices of an allocation back from the GPU, which waits for it to be done with them.
+	// Each span must hold exactly as many bytes as the allocation does.
+	void download(const GeometryAllocation& allocation, std::span<std::byte> vertices, std::span<std::byte> indices) const;
+
+	[[nodiscard]] const std::vector<GenericAttribute>& getLayout(const GeometryAllocation& allocation) const;
+
+	[[nodiscard]] GLuint getVertexArray(const GeometryAllocation& allocation) const;
+
+	// The buffer holding the vertices of the allocation page, for VAOs of their own to read them.
+	[[nodiscard]] GLuint getVertexBuffer(const GeometryAllocation& allocation) const;
+
+	[[nodiscard]] GLuint getCommandBuffer(const CommandAllocation& allocation) const;
+
+	// Creates a VAO reading the indices of the allocation page but the vertices of another buffer.
+	// The caller owns it and binds the vertex buffer, at whatever offset, to binding 0.
+	[[nodiscard]] GLuint createVertexArray(const GeometryAllocation& allocation) const;
+
+	// Same as above, for vertices in another format than the page's, such as those of index-only allocations.
+	[[nodiscard]] GLuint createVertexArray(const GeometryAllocation& allocation, const std::vector<GenericAttribute>& layout) const;
+
+	void destroy();
+
+	static constexpr std::size_t VERTEX_PAGE_BYTES = 16 * 1024 * 1024;
+	static constexpr std::size_t INDEX_PAGE_BYTES = 8 * 1024 * 1024;
+	static constexpr std::size_t COMMAND_PAGE_COUNT = 16 * 1024;
+
+	// Index ranges start on a 4-byte boundary, whichever index type they hold.
+	static constexpr std::size_t INDEX_ALIGNMENT = 4;
+
+private:
+	struct Page {
+		std::vector<GenericAttribute> layout;
+		std::size_t stride;
+		GLuint vao;
+		GLuint vertexBuffer;
+		GLuint indexBuffer;
+		BufferAllocator vertices;	// in vertices
+		BufferAllocator indices;	// in bytes
+	};
+
+	struct CommandPage {
+		GLuint buffer;
+		BufferAllocator commands;	// in commands
+	};
+
+	std::vector<Page> _pages{};
+
+	std::vector<CommandPage> _commandPages{};
+
+	// Uploads take consecutive slices of the current region and only move on to the next one once it is
+	// full, so loading many meshes in a row waits for the GPU only when the ring wraps onto a region it
+	// still copies from.
+	std::unique_ptr<StreamBuffer> _staging{};
+	std::span<std::byte> _stagingRegion{};
+	std::size_t _stagingHead{ 0 };
+
+	static constexpr std::size_t STAGING_REGION_BYTES = 8 * 1024 * 1024;
+	static constexpr std::size_t STAGING_REGION_COUNT = StreamBuffer::DEFAULT_REGION_COUNT;
+
+	// Reserves a slice of the current staging region, returning its offset in the region.
+	[[nodiscard]] std::size_t allocateStaging(std::size_t bytes);
+
+	Page& createPage(const std::vector<GenericAttribute>& layout, std::size_t vertexCount, std::size_t indexBytes);
+
+	[[nodiscard]] static GLuint createBuffer(std::size_t size);
+
+	[[nodiscard]] static GLuint createVertexArray(const std::vector<GenericAttribute>& layout, GLuint indexBuffer);
+
+	[[nodiscard]] static bool sameLayout(const std::vector<GenericAttribute>& a, const std::vector<GenericAttribute>& b);
+
+	struct AttributeFormat {
+		GLenum type;
+		GLint size;
+		GLboolean normalized;
+	};
+
+	[[nodiscard]] static AttributeFormat getAttributeFormat(const GenericAttribute& attribute);
+};
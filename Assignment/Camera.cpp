@@ -6,35 +6,65 @@ void Camera::relativeDrag(const float offsetX, const float offsetY) {
 	_phi -= offsetX * DRAG_SENSITIVE;
 	_theta -= offsetY * DRAG_SENSITIVE;
 	_theta = glm::clamp(_theta, MIN_THETA, MAX_THETA);
+	_viewStale = true;
+	++_version;
 }
 
 void Camera::relativeZoom(const float amount) {
 	_radius -= amount * ZOOM_SENSITIVE;
 	_radius = glm::clamp(_radius, MIN_RADIUS, MAX_RADIUS);
+	_viewStale = true;
+	++_version;
 }
 
 void Camera::setProjection(const float fov, const float ratio, const float near, const float far) {
 	_projection = glm::perspective(fov, ratio, near, far);
+	_near = near;
+	_far = far;
+	++_version;
 }
 
 void Camera::setProjection(const float left, const float right, const float bottom, const float top, const float zNear, const float zFar) {
 	_projection = glm::ortho(left, right, bottom, top, zNear, zFar);
+	_near = zNear;
+	_far = zFar;
+	++_version;
 }
 
 glm::mat4 Camera::getProjection() const {
 	return _projection;
 }
 
-glm::mat4 Camera::getViewMatrix() const {
-	const auto pos = glm::vec3{
-		_radius * glm::sin(glm::radians(_theta)) * glm::cos(glm::radians(_phi)),
-		_radius * glm::sin(glm::radians(_theta)) * glm::sin(glm::radians(_phi)),
-		_radius * glm::cos(glm::radians(_theta))
-	};
-	return lookAt(pos, glm::vec3{ 0.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, 1.0f });
+float Camera::getNear() const {
+	return _near;
 }
 
+float Camera::getFar() const {
+	return _far;
+}
 
+std::uint64_t Camera::getVersion() const {
+	return _version;
+}
 
+glm::mat4 Camera::getViewMatrix() const {
+	if (_viewStale) {
+		const auto pos = glm::vec3{
+			_radius * glm::sin(glm::radians(_theta)) * glm::cos(glm::radians(_phi)),
+			_radius * glm::sin(glm::radians(_theta)) * glm::sin(glm::radians(_phi)),
+			_radius * glm::cos(glm::radians(_theta))
+		};
+		_view = lookAt(pos, glm::vec3{ 0.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, 1.0f });
+		_viewStale = false;
+	}
+	return _view;
+}
 
-
+Camera::Ray Camera::getRay(const float x, const float y) const {
+	const auto inverse = glm::inverse(_projection * getViewMatrix());
+	auto nearPoint = inverse * glm::vec4{ x, y, -1.0f, 1.0f };
+	auto farPoint = inverse * glm::vec4{ x, y, 1.0f, 1.0f };
+	nearPoint /= nearPoint.w;
+	farPoint /= farPoint.w;
+	return Ray{ glm::vec3{ nearPoint }, glm::normalize(glm::vec3{ farPoint } - glm::vec3{ nearPoint }) };
+}
@@ -2,6 +2,8 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <cstdint>
+
 #include "EntityManager.h"
 
 class Camera : public EntityResource {
@@ -12,12 +14,28 @@ public:
 
 	[[nodiscard]] glm::mat4 getProjection() const;
 
+	[[nodiscard]] float getNear() const;
+
+	[[nodiscard]] float getFar() const;
+
 	[[nodiscard]] glm::mat4 getViewMatrix() const;
 
+	struct Ray {
+		glm::vec3 origin;
+		glm::vec3 direction;	// normalized
+	};
+
+	// The ray from the near plane through the point, given in normalized device coordinates.
+	[[nodiscard]] Ray getRay(float x, float y) const;
+
 	void relativeDrag(float offsetX, float offsetY);
 
 	void relativeZoom(float amount);
 
+	// Goes up every time the view or the projection changes, so each renderer can tell on its own
+	// whether the matrices it last uploaded are still current.
+	[[nodiscard]] std::uint64_t getVersion() const;
+
 	friend class Engine;
 
 private:
@@ -31,6 +49,17 @@ private:
 
 	glm::mat4 _projection;
 
+	// The view matrix is only rebuilt when the orbit parameters changed.
+	mutable glm::mat4 _view{ 1.0f };
+
+	mutable bool _viewStale{ true };
+
+	std::uint64_t _version{ 1 };
+
+	float _near{ DEFAULT_NEAR };
+
+	float _far{ DEFAULT_FAR };
+
 	static constexpr auto MIN_RADIUS = 1.0f;
 	static constexpr auto MAX_RADIUS = 50.0f;
 
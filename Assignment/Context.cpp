@@ -8,6 +8,7 @@
 static std::vector<std::function<void(int, int)>> mFramebufferCallbacks{};
 static std::function<void(float)> mMouseScrollCallback{ [](auto) {} };
 static std::function<void(float, float)> mMouseDragPerpetualCallback{ [](auto, auto) {} };
+static std::function<void(float, float)> mCursorMoveCallback{ [](auto, auto) {} };
 
 static GLFWwindow* mWindow = nullptr;
 static bool mDragging = false;
@@ -76,6 +77,27 @@ Context::Context(const std::string_view name, const int width, const int height)
 			}
 		}
 	});
+
+	// one callback serves both dragging and cursor moves, as GLFW only keeps one
+	glfwSetCursorPosCallback(_window, [](auto window, const auto xPos, const auto yPos) {
+		if (mDragging) {
+			const auto offsetX = static_cast<float>(xPos) - mLastX;
+			const auto offsetY = static_cast<float>(yPos) - mLastY;
+			mLastX = static_cast<float>(xPos);
+			mLastY = static_cast<float>(yPos);
+
+			mMouseDragPerpetualCallback(offsetX, offsetY);
+		}
+
+		int width, height;
+		glfwGetWindowSize(window, &width, &height);
+		if (width > 0 && height > 0) {
+			mCursorMoveCallback(
+				2.0f * static_cast<float>(xPos) / static_cast<float>(width) - 1.0f,
+				1.0f - 2.0f * static_cast<float>(yPos) / static_cast<float>(height)
+			);
+		}
+	});
 }
 
 void Context::setClose(const bool close) const {
@@ -100,16 +122,10 @@ void Context::setMouseScrollCallback(const std::function<void(float)>& callback)
 
 void Context::setMouseDragPerpetualCallback(const std::function<void(float, float)>& callback) const {
 	mMouseDragPerpetualCallback = callback;
-	glfwSetCursorPosCallback(_window, [](auto _, const auto xPos, const auto yPos) {
-		if (mDragging) {
-			const auto offsetX = static_cast<float>(xPos) - mLastX;
-			const auto offsetY = static_cast<float>(yPos) - mLastY;
-			mLastX = static_cast<float>(xPos);
-			mLastY = static_cast<float>(yPos);
+}
 
-			mMouseDragPerpetualCallback(offsetX, offsetY);
-		}
-	});
+void Context::setCursorMoveCallback(const std::function<void(float, float)>& callback) const {
+	mCursorMoveCallback = callback;
 }
 
 
@@ -38,6 +38,9 @@ public:
 
 	void setMouseDragPerpetualCallback(const std::function<void(float, float)>& callback) const;
 
+	// Called with the cursor position in normalized device coordinates whenever it moves, dragging or not.
+	void setCursorMoveCallback(const std::function<void(float, float)>& callback) const;
+
 	void loop(const std::function<void()>& onFrame);
 
 	[[nodiscard]] float getCurrentTime() const;
@@ -0,0 +1,348 @@
+#include <array>
+
+#include "DynamicBvh.h"
+
+DynamicBvh::Proxy DynamicBvh::insert(const glm::vec3& min, const glm::vec3& max, const std::uint32_t value) {
+	const auto leaf = allocateNode();
+	const auto margin = glm::vec3{ MARGIN * std::max({ max.x - min.x, max.y - min.y, max.z - min.z }) };
+	_nodes[leaf].min = min - margin;
+	_nodes[leaf].max = max + margin;
+	_nodes[leaf].value = value;
+	insertLeaf(leaf);
+	++_leafCount;
+	return leaf;
+}
+
+void DynamicBvh::remove(const Proxy proxy) {
+	removeLeaf(proxy);
+	freeNode(proxy);
+	--_leafCount;
+}
+
+bool DynamicBvh::move(const Proxy proxy, const glm::vec3& min, const glm::vec3& max) {
+	auto& leaf = _nodes[proxy];
+	if (leaf.min.x <= min.x && leaf.min.y <= min.y && leaf.min.z <= min.z
+		&& max.x <= leaf.max.x && max.y <= leaf.max.y && max.z <= leaf.max.z) {
+		return false;
+	}
+
+	removeLeaf(proxy);
+	const auto margin = glm::vec3{ MARGIN * std::max({ max.x - min.x, max.y - min.y, max.z - min.z }) };
+	leaf.min = min - margin;
+	leaf.max = max + margin;
+	insertLeaf(proxy);
+	return true;
+}
+
+void DynamicBvh::setValue(const Proxy proxy, const std::uint32_t value) {
+	_nodes[proxy].value = value;
+}
+
+std::uint32_t DynamicBvh::getValue(const Proxy proxy) const {
+	return _nodes[proxy].value;
+}
+
+void DynamicBvh::rebuild() {
+	if (_root == NONE) {
+		return;
+	}
+
+	// keep the leaves, and throw away every node above them
+	auto leaves = std::vector<Proxy>{};
+	leaves.reserve(_leafCount);
+	for (auto index = Proxy{ 0 }; index < static_cast<Proxy>(_nodes.size()); ++index) {
+		if (_nodes[index].height == 0) {
+			leaves.push_back(index);
+		} else if (_nodes[index].height > 0) {
+			freeNode(index);
+		}
+	}
+
+	_root = build(leaves);
+	_nodes[_root].parent = NONE;
+}
+
+int DynamicBvh::getHeight() const {
+	return _root == NONE ? 0 : _nodes[_root].height;
+}
+
+std::size_t DynamicBvh::getLeafCount() const {
+	return _leafCount;
+}
+
+DynamicBvh::Proxy DynamicBvh::allocateNode() {
+	auto index = static_cast<Proxy>(_nodes.size());
+	if (!_freeNodes.empty()) {
+		index = _freeNodes.back();
+		_freeNodes.pop_back();
+	} else {
+		_nodes.emplace_back();
+	}
+	_nodes[index] = Node{ glm::vec3{ 0.0f }, glm::vec3{ 0.0f }, NONE, NONE, NONE, 0, 0 };
+	return index;
+}
+
+void DynamicBvh::freeNode(const Proxy index) {
+	_nodes[index].height = -1;
+	_freeNodes.push_back(index);
+}
+
+void DynamicBvh::insertLeaf(const Proxy leaf) {
+	if (_root == NONE) {
+		_root = leaf;
+		_nodes[leaf].parent = NONE;
+		return;
+	}
+
+	// Walk down towards the sibling where the leaf adds the least surface area. Pairing up with a node
+	// costs the area of a new parent around both, and every ancestor above grows by as much as that node does.
+	const auto leafMin = _nodes[leaf].min;
+	const auto leafMax = _nodes[leaf].max;
+	auto index = _root;
+	while (!_nodes[index].isLeaf()) {
+		const auto& node = _nodes[index];
+		const auto area = surfaceArea(node.min, node.max);
+		const auto combinedArea = surfaceArea(glm::min(node.min, leafMin), glm::max(node.max, leafMax));
+		const auto cost = 2.0f * combinedArea;
+		const auto inheritance = 2.0f * (combinedArea - area);
+
+		const auto descend = [&](const Proxy child) {
+			const auto& c = _nodes[child];
+			const auto grown = surfaceArea(glm::min(c.min, leafMin), glm::max(c.max, leafMax));
+			return (c.isLeaf() ? grown : grown - surfaceArea(c.min, c.max)) + inheritance;
+		};
+		const auto leftCost = descend(node.left);
+		const auto rightCost = descend(node.right);
+
+		if (cost < leftCost && cost < rightCost) {
+			break;
+		}
+		index = leftCost < rightCost ? node.left : node.right;
+	}
+
+	// a new parent takes the sibling's place, with the sibling and the leaf under it
+	const auto sibling = index;
+	const auto oldParent = _nodes[sibling].parent;
+	const auto newParent = allocateNode();
+	_nodes[newParent].parent = oldParent;
+	_nodes[newParent].left = sibling;
+	_nodes[newParent].right = leaf;
+	_nodes[sibling].parent = newParent;
+	_nodes[leaf].parent = newParent;
+	refit(newParent);
+
+	if (oldParent == NONE) {
+		_root = newParent;
+	} else if (_nodes[oldParent].left == sibling) {
+		_nodes[oldParent].left = newParent;
+	} else {
+		_nodes[oldParent].right = newParent;
+	}
+
+	refitUpwards(oldParent);
+}
+
+void DynamicBvh::removeLeaf(const Proxy leaf) {
+	if (leaf == _root) {
+		_root = NONE;
+		return;
+	}
+
+	// the sibling takes the place of the parent, which goes away
+	const auto parent = _nodes[leaf].parent;
+	const auto grandParent = _nodes[parent].parent;
+	const auto sibling = _nodes[parent].left == leaf ? _nodes[parent].right : _nodes[parent].left;
+	freeNode(parent);
+
+	_nodes[sibling].parent = grandParent;
+	if (grandParent == NONE) {
+		_root = sibling;
+		return;
+	}
+
+	if (_nodes[grandParent].left == parent) {
+		_nodes[grandParent].left = sibling;
+	} else {
+		_nodes[grandParent].right = sibling;
+	}
+	refitUpwards(grandParent);
+}
+
+void DynamicBvh::refitUpwards(Proxy index) {
+	while (index != NONE) {
+		index = balance(index);
+		refit(index);
+		index = _nodes[index].parent;
+	}
+}
+
+DynamicBvh::Proxy DynamicBvh::balance(const Proxy index) {
+	auto& a = _nodes[index];
+	if (a.isLeaf() || a.height < 2) {
+		return index;
+	}
+
+	// the taller child moves up into the node's place, the node going down to become its child
+	// and keeping the shorter of the taller child's own children
+	const auto difference = _nodes[a.right].height - _nodes[a.left].height;
+	if (difference >= -1 && difference <= 1) {
+		return index;
+	}
+
+	const auto risingRight = difference > 1;
+	const auto rising = risingRight ? a.right : a.left;
+	auto& r = _nodes[rising];
+
+	// the rising child takes the node's place under its parent
+	r.parent = a.parent;
+	a.parent = rising;
+	if (r.parent == NONE) {
+		_root = rising;
+	} else if (_nodes[r.parent].left == index) {
+		_nodes[r.parent].left = rising;
+	} else {
+		_nodes[r.parent].right = rising;
+	}
+
+	// of the rising child's children, the taller stays with it and the shorter goes down with the node
+	const auto tallerFirst = _nodes[r.left].height > _nodes[r.right].height;
+	const auto taller = tallerFirst ? r.left : r.right;
+	const auto shorter = tallerFirst ? r.right : r.left;
+
+	r.left = index;
+	r.right = taller;
+	if (risingRight) {
+		a.right = shorter;
+	} else {
+		a.left = shorter;
+	}
+	_nodes[shorter].parent = index;
+
+	refit(index);
+	refit(rising);
+	return rising;
+}
+
+DynamicBvh::Proxy DynamicBvh::build(const std::span<Proxy> leaves) {
+	if (leaves.size() == 1) {
+		return leaves.front();
+	}
+
+	const auto center = [&](const Proxy leaf) {
+		return (_nodes[leaf].min + _nodes[leaf].max) * 0.5f;
+	};
+
+	// split along the axis the centers spread the most over
+	auto centerMin = center(leaves.front());
+	auto centerMax = centerMin;
+	for (const auto leaf : leaves) {
+		centerMin = glm::min(centerMin, center(leaf));
+		centerMax = glm::max(centerMax, center(leaf));
+	}
+	const auto spread = centerMax - centerMin;
+	const auto axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+
+	auto middle = leaves.size() / 2;
+	if (spread[axis] > 0.0f) {
+		// sort the centers into bins, and split between the bins where the areas weighted by the leaf counts
+		// on either side add up the least
+		const auto binOf = [&](const Proxy leaf) {
+			const auto bin = static_cast<int>((center(leaf)[axis] - centerMin[axis]) / spread[axis] * SAH_BINS);
+			return std::min(bin, SAH_BINS - 1);
+		};
+
+		struct Bin {
+			glm::vec3 min{ std::numeric_limits<float>::max() };
+			glm::vec3 max{ std::numeric_limits<float>::lowest() };
+			std::size_t count{ 0 };
+		};
+		auto bins = std::array<Bin, SAH_BINS>{};
+		for (const auto leaf : leaves) {
+			auto& bin = bins[binOf(leaf)];
+			bin.min = glm::min(bin.min, _nodes[leaf].min);
+			bin.max = glm::max(bin.max, _nodes[leaf].max);
+			++bin.count;
+		}
+
+		// the cost of everything right of each split, swept from the right
+		auto rightCosts = std::array<float, SAH_BINS>{};
+		auto sweep = Bin{};
+		for (auto b = SAH_BINS - 1; b > 0; --b) {
+			sweep.min = glm::min(sweep.min, bins[b].min);
+			sweep.max = glm::max(sweep.max, bins[b].max);
+			sweep.count += bins[b].count;
+			rightCosts[b] = sweep.count == 0 ? 0.0f : surfaceArea(sweep.min, sweep.max) * static_cast<float>(sweep.count);
+		}
+
+		auto bestSplit = 0;
+		auto bestCost = std::numeric_limits<float>::max();
+		sweep = Bin{};
+		for (auto b = 1; b < SAH_BINS; ++b) {
+			sweep.min = glm::min(sweep.min, bins[b - 1].min);
+			sweep.max = glm::max(sweep.max, bins[b - 1].max);
+			sweep.count += bins[b - 1].count;
+			if (sweep.count == 0 || sweep.count == leaves.size()) {
+				continue;
+			}
+			const auto cost = surfaceArea(sweep.min, sweep.max) * static_cast<float>(sweep.count) + rightCosts[b];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestSplit = b;
+			}
+		}
+
+		if (bestSplit > 0) {
+			const auto split = std::partition(leaves.begin(), leaves.end(), [&](const auto leaf) {
+				return binOf(leaf) < bestSplit;
+			});
+			middle = static_cast<std::size_t>(split - leaves.begin());
+		}
+	}
+
+	const auto left = build(leaves.first(middle));
+	const auto right = build(leaves.subspan(middle));
+	const auto node = allocateNode();
+	_nodes[node].left = left;
+	_nodes[node].right = right;
+	_nodes[left].parent = node;
+	_nodes[right].parent = node;
+	refit(node);
+	return node;
+}
+
+void DynamicBvh::refit(const Proxy index) {
+	auto& node = _nodes[index];
+	const auto& left = _nodes[node.left];
+	const auto& right = _nodes[node.right];
+	node.min = glm::min(left.min, right.min);
+	node.max = glm::max(left.max, right.max);
+	node.height = 1 + std::max(left.height, right.height);
+}
+
+float DynamicBvh::surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+	const auto extent = max - min;
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+bool DynamicBvh::overlaps(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB) {
+	return minA.x <= maxB.x && minB.x <= maxA.x
+		&& minA.y <= maxB.y && minB.y <= maxA.y
+		&& minA.z <= maxB.z && minB.z <= maxA.z;
+}
+
+std::optional<float> DynamicBvh::intersectRay(
+	const glm::vec3& origin, const glm::vec3& inverseDirection, const float maxDistance,
+	const glm::vec3& min, const glm::vec3& max
+) {
+	// the ray is inside the box between entering the last of the slabs and leaving the first
+	const auto t1 = (min - origin) * inverseDirection;
+	const auto t2 = (max - origin) * inverseDirection;
+	const auto near = glm::min(t1, t2);
+	const auto far = glm::max(t1, t2);
+	const auto entry = std::max({ near.x, near.y, near.z, 0.0f });
+	const auto exit = std::min({ far.x, far.y, far.z, maxDistance });
+	if (entry > exit) {
+		return std::nullopt;
+	}
+	return entry;
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Frustum.h"
+
+// A bounding volume hierarchy of boxes that come, go and move. Every box is a leaf, under a binary tree
+// of boxes around their children, so a query only walks the branches it overlaps, O(log n) of them
+// for a query touching few leaves.
+// Leaves go in next to the sibling that grows the total surface area the least, and rotations keep the
+// tree balanced as they come and go. Each leaf keeps a margin around its box, so small moves do not
+// touch the tree at all.
+class DynamicBvh {
+public:
+	// A leaf of the tree, which stays the same for as long as the box is in it.
+	using Proxy = int;
+
+	static constexpr auto NONE = Proxy{ -1 };
+
+	// Inserts the box along with a value for the queries to hand back.
+	[[nodiscard]] Proxy insert(const glm::vec3& min, const glm::vec3& max, std::uint32_t value);
+
+	void remove(Proxy proxy);
+
+	// Returns whether the tree changed, which is only when the box leaves the margin of the leaf.
+	bool move(Proxy proxy, const glm::vec3& min, const glm::vec3& max);
+
+	void setValue(Proxy proxy, std::uint32_t value);
+
+	[[nodiscard]] std::uint32_t getValue(Proxy proxy) const;
+
+	// Rebuilds the whole tree top down with the surface area heuristic, which gives tighter trees than
+	// inserting one leaf at a time, at the cost of going through every leaf.
+	void rebuild();
+
+	// The longest path from the root to a leaf.
+	[[nodiscard]] int getHeight() const;
+
+	[[nodiscard]] std::size_t getLeafCount() const;
+
+	// Calls visit(value, contained) for every leaf whose box is inside or crosses the frustum,
+	// contained telling whether the box is known to lie wholly inside.
+	template<typename F>
+	void query(const Frustum& frustum, F&& visit) const {
+		if (_root == NONE) {
+			return;
+		}
+
+		// once a box is inside, everything under it is too
+		auto stack = std::vector<std::pair<Proxy, bool>>{ { _root, false } };
+		while (!stack.empty()) {
+			auto [index, contained] = stack.back();
+			stack.pop_back();
+
+			const auto& node = _nodes[index];
+			if (!contained) {
+				const auto containment = frustum.classify(node.min, node.max);
+				if (containment == Frustum::Containment::OUTSIDE) {
+					continue;
+				}
+				contained = containment == Frustum::Containment::INSIDE;
+			}
+
+			if (node.isLeaf()) {
+				visit(node.value, contained);
+			} else {
+				stack.emplace_back(node.left, contained);
+				stack.emplace_back(node.right, contained);
+			}
+		}
+	}
+
+	// Calls visit(value) for every leaf whose box overlaps the given one.
+	template<typename F>
+	void query(const glm::vec3& min, const glm::vec3& max, F&& visit) const {
+		if (_root == NONE) {
+			return;
+		}
+
+		auto stack = std::vector{ _root };
+		while (!stack.empty()) {
+			const auto& node = _nodes[stack.back()];
+			stack.pop_back();
+			if (!overlaps(node.min, node.max, min, max)) {
+				continue;
+			}
+
+			if (node.isLeaf()) {
+				visit(node.value);
+			} else {
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+
+	// Calls visit(value, distance) for the leaves whose box the ray enters within the distance, with the
+	// distance it enters at, going down the nearer branch first. Whatever visit returns becomes the distance
+	// left to search, so returning the distance of a hit skips everything behind it, and returning 0 stops.
+	template<typename F>
+	void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, F&& visit) const {
+		if (_root == NONE) {
+			return;
+		}
+
+		const auto inverse = 1.0f / direction;
+		auto stack = std::vector{ _root };
+		while (!stack.empty() && maxDistance > 0.0f) {
+			const auto& node = _nodes[stack.back()];
+			stack.pop_back();
+
+			const auto entry = intersectRay(origin, inverse, maxDistance, node.min, node.max);
+			if (!entry) {
+				continue;
+			}
+
+			if (node.isLeaf()) {
+				maxDistance = std::min(maxDistance, visit(node.value, *entry));
+				continue;
+			}
+
+			// the nearer child goes on top, so it gets searched first
+			const auto left = intersectRay(origin, inverse, maxDistance, _nodes[node.left].min, _nodes[node.left].max);
+			const auto right = intersectRay(origin, inverse, maxDistance, _nodes[node.right].min, _nodes[node.right].max);
+			const auto leftFirst = left && (!right || *left <= *right);
+			if (left && right) {
+				stack.push_back(leftFirst ? node.right : node.left);
+				stack.push_back(leftFirst ? node.left : node.right);
+			} else if (left || right) {
+				stack.push_back(left ? node.left : node.right);
+			}
+		}
+	}
+
+	// Where the ray, given by the inverse of its direction, enters the box, unless it misses it within the distance.
+	static [[nodiscard]] std::optional<float> intersectRay(
+		const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance,
+		const glm::vec3& min, const glm::vec3& max
+	);
+
+	// How much larger than its box, relative to its size, a leaf is kept.
+	static constexpr auto MARGIN = 0.1f;
+
+private:
+	struct Node {
+		glm::vec3 min;
+		glm::vec3 max;
+		Proxy parent;
+		Proxy left;		// NONE for leaves
+		Proxy right;
+		int height;		// 0 for leaves, -1 for freed nodes
+		std::uint32_t value;
+
+		[[nodiscard]] bool isLeaf() const {
+			return left == NONE;
+		}
+	};
+
+	// The number of bins the centers get sorted into along an axis when rebuilding.
+	static constexpr auto SAH_BINS = 16;
+
+	[[nodiscard]] Proxy allocateNode();
+
+	void freeNode(Proxy index);
+
+	void insertLeaf(Proxy leaf);
+
+	void removeLeaf(Proxy leaf);
+
+	// Refits and rebalances every node from the given one up to the root.
+	void refitUpwards(Proxy index);
+
+	// Rotates the node's taller child up if the heights of its children differ by more than one,
+	// returning whichever node now sits where it was.
+	[[nodiscard]] Proxy balance(Proxy index);
+
+	// Builds a subtree over the leaves, returning its root.
+	[[nodiscard]] Proxy build(std::span<Proxy> leaves);
+
+	void refit(Proxy index);
+
+	static [[nodiscard]] float surfaceArea(const glm::vec3& min, const glm::vec3& max);
+
+	static [[nodiscard]] bool overlaps(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB);
+
+	std::vector<Node> _nodes{};
+
+	Proxy _root{ NONE };
+
+	// Freed nodes, reused before the array grows.
+	std::vector<Proxy> _freeNodes{};
+
+	std::size_t _leafCount{ 0 };
+};
@@ -1,12 +1,21 @@
 #include <glad/glad.h>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include <span>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <tuple>
 #include <exception>
+#include <format>
+#include <stdexcept>
 #include <memory>
+#include <ranges>
 
 #include "Engine.h"
+#include "Shader.h"
 
 std::unique_ptr<Engine> Engine::Factory::operator()(const Context& context) const {
 	return std::unique_ptr<Engine>(new Engine{ context });
@@ -20,6 +29,8 @@ std::unique_ptr<Engine> Engine::create(const Context& context) {
 Engine::Engine(const Context& context) {
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_MULTISAMPLE);
+	// the restart index is the maximum value of whichever index type a draw uses
+	glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
 
 	context.registerFramebufferCallback([](const auto w, const auto h) {
 		// make sure the viewport matches the new window dimensions
@@ -29,7 +40,28 @@ Engine::Engine(const Context& context) {
 }
 
 EntityManager* Engine::getEntityManager() const {
-	return _entityManager;
+	return EntityManager::get();
+}
+
+TransformManager* Engine::getTransformManager() {
+	return &_transformManager;
+}
+
+RenderableManager* Engine::getRenderableManager() {
+	return &_renderableManager;
+}
+
+void Engine::updateTransforms() {
+	_transformManager.update();
+
+	// few entities move in a frame, so looking each up beats going through the scenes
+	for (const auto scene : _scenes) {
+		for (const auto instance : _transformManager._changed) {
+			if (const auto it = scene->_indices.find(_transformManager._entities[instance]); it != scene->_indices.end()) {
+				scene->updateBounds(it->second);
+			}
+		}
+	}
 }
 
 Camera* Engine::createCamera(const Entity entity, const float initialRatio) {
@@ -38,12 +70,42 @@ Camera* Engine::createCamera(const Entity entity, const float initialRatio) {
 	return camera;
 }
 
+Renderer* Engine::createRenderer() {
+	const auto renderer = new Renderer(*this);
+	_renderers.push_back(renderer);
+	return renderer;
+}
+
+void Engine::destroyRenderer(const Renderer* const renderer) {
+	destroyResource(_renderers, renderer);
+}
+
+Scene* Engine::createScene() {
+	const auto scene = new Scene(*this);
+	_scenes.push_back(scene);
+	return scene;
+}
+
+void Engine::destroyScene(const Scene* const scene) {
+	destroyResource(_scenes, scene);
+}
+
+View* Engine::createView() {
+	const auto view = new View();
+	_views.push_back(view);
+	return view;
+}
 
-void Engine::setClearColor(const float r, const float g, const float b, const float a) {
-	_clearColor[0] = r;
-	_clearColor[1] = g;
-	_clearColor[2] = b;
-	_clearColor[3] = a;
+void Engine::destroyView(const View* const view) {
+	destroyResource(_views, view);
+}
+
+template<typename T>
+void Engine::destroyResource(std::vector<T*>& resources, const T* const resource) {
+	if (const auto it = std::ranges::find(resources, resource); it != resources.end()) {
+		delete *it;
+		resources.erase(it);
+	}
 }
 
 void Engine::setPolygonMode(const PolygonMode mode) {
@@ -51,195 +113,677 @@ void Engine::setPolygonMode(const PolygonMode mode) {
 }
 
 
-Renderable Engine::loadMesh(const Drawable& drawable) {
-	const auto vertices = drawable.vertices();
-	const auto layout = drawable.layout();
-	const auto primitives = drawable.primitives();
+Renderable Engine::loadMesh(const Drawable& drawable, const LoadOptions& options) {
+	const auto renderable = loadLevel(drawable, options);
 
-	unsigned int vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	// The renderer draws one of the levels in place of the finest, depending on its size on screen
+	if (const auto coarser = drawable.coarserLevels(); !coarser.empty()) {
+		auto levels = std::vector{ renderable };
+		for (const auto& level : coarser) {
+			levels.push_back(loadLevel(*level, options));
+		}
+		_lodChains.emplace(renderable, std::move(levels));
+	}
 
-	createVertexBuffer(vertices, layout);
-	createIndexBuffer(primitives);
+	return renderable;
+}
 
-	glBindVertexArray(0);
+Renderable Engine::loadLevel(const Drawable& drawable, const LoadOptions& options) {
+	if (!options.stitch && !options.optimize) {
+		if (const auto size = drawable.size()) {
+			return loadDirect(drawable, *size, options);
+		}
+	}
 
-	const auto renderable = static_cast<Renderable>(_meshes.size());
-	_meshes.emplace_back(vao, drawable.shader, createElements(primitives));
+	const auto [vertices, layout, ranges, indexType, stats] = prepareGeometry(drawable, options);
+
+	const auto packedVertices = packVertices(vertices, layout);
+	const auto packedIndices = joinIndices(ranges, indexType);
+
+	const auto geometry = _arena.allocate(layout, packedVertices.size() / vertexStride(layout), packedIndices.size());
+	_arena.upload(geometry, packedVertices, packedIndices);
+
+	const auto indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	auto elements = createElements(ranges, geometry.indexOffset / indexSize, geometry.baseVertex);
+	auto [commands, batches] = createIndirectCommands(elements);
+
+	return storeMesh(
+		Mesh{
+			_arena.getVertexArray(geometry), drawable.shader, std::move(elements),
+			_arena.getCommandBuffer(commands), std::move(batches), indexType, geometry, commands,
+			computeBounds(vertices, vertexComponents(layout))
+		},
+		stats
+	);
+}
+
+Renderable Engine::createDynamicMesh(const Drawable& drawable, const LoadOptions& options) {
+	// Updates address the vertices the way the drawable produced them, so they must not be reordered
+	auto dynamicOptions = options;
+	dynamicOptions.optimize = false;
+	const auto [vertices, layout, ranges, indexType, stats] = prepareGeometry(drawable, dynamicOptions);
+
+	// Only the indices go to the arena, into whichever page has room, the vertices live in a ring of mapped regions
+	const auto packedIndices = joinIndices(ranges, indexType);
+	const auto geometry = _arena.allocate(layout, 0, packedIndices.size());
+	_arena.upload(geometry, {}, packedIndices);
+
+	const auto stride = vertexStride(layout);
+	const auto vertexCount = vertices.size() / vertexComponents(layout);
+	auto stream = std::make_unique<StreamBuffer>(std::max<std::size_t>(vertexCount * stride, 1));
+	const auto vao = _arena.createVertexArray(geometry, layout);
+
+	// Base vertices stay relative to the region, which is bound at its offset on every update
+	const auto indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	auto elements = createElements(ranges, geometry.indexOffset / indexSize, 0);
+	auto [commands, batches] = createIndirectCommands(elements);
+
+	const auto renderable = storeMesh(
+		Mesh{
+			vao, drawable.shader, std::move(elements),
+			_arena.getCommandBuffer(commands), std::move(batches), indexType, geometry, commands,
+			computeBounds(vertices, vertexComponents(layout))
+		},
+		stats
+	);
+	// Fill every region, so partial updates find complete vertices wherever they land
+	const auto regionCount = stream->getRegionCount();
+	_dynamicMeshes.emplace(renderable, DynamicMesh{ std::move(stream), layout, vertexCount, findMesh(renderable)->bounds });
+	for (std::size_t i = 0; i < regionCount; ++i) {
+		updateDynamicMesh(renderable, vertices);
+	}
 
 	return renderable;
 }
 
-void Engine::createVertexBuffer(
-	const std::vector<float>& vertices, 
-	const std::vector<GenericAttribute>& layout
-) {
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+void Engine::updateDynamicMesh(const Renderable renderable, const std::vector<float>& vertices) {
+	const auto& [stream, layout, vertexCount, bounds] = _dynamicMeshes.at(renderable);
+	if (vertices.size() / vertexComponents(layout) > vertexCount) {
+		throw std::invalid_argument("A dynamic mesh cannot grow past the vertex count it was created with.");
+	}
+
+	updateDynamicMesh(renderable, [&vertices, &layout](const auto region) {
+		packVertices(vertices, layout, region);
+		return computeBounds(vertices, vertexComponents(layout));
+	});
+}
 
-	// We transfer the data down the GPU by mean of std::mem copy.
+void Engine::updateDynamicMesh(const Renderable renderable, const std::function<MeshBounds(std::span<std::byte>)>& writer) {
+	auto& [stream, layout, vertexCount, bounds] = _dynamicMeshes.at(renderable);
 
-	// Create a dedicated memory region in the GPU.
-	glBufferStorage(
-		GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(float) * vertices.size()),
-		nullptr, GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT
+	const auto region = stream->map();
+	bounds = writer(region.first(vertexCount * vertexStride(layout)));
+	_renderableManager.updateMeshBounds(renderable, bounds);
+
+	// The VAO is not part of the renderer's bound state between frames, so rebinding it here is safe
+	glBindVertexArray(findMesh(renderable)->vao);
+	glBindVertexBuffer(
+		0, stream->getBuffer(), static_cast<GLintptr>(stream->getOffset()),
+		static_cast<GLsizei>(vertexStride(layout))
 	);
+	glBindVertexArray(0);
+}
+
+Renderable Engine::createInstancedMesh(const Renderable renderable, const std::size_t capacity) {
+	const auto source = findMesh(renderable);
+	if (!source || _dynamicMeshes.contains(renderable) || _instancedMeshes.contains(renderable)) {
+		throw std::invalid_argument("Only loaded static meshes can be instanced.");
+	}
 
-	// Acquire the pointer to the newly created memory.
-	const auto vertexData = static_cast<float*>(glMapBufferRange(
-		GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(sizeof(float) * vertices.size()),
-		GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT
-	));
-	if (!vertexData) {
-		throw std::exception("Could not map vertex buffer.");
-	}
-
-	// Transfer the vertices data.
-	std::memcpy(vertexData, vertices.data(), sizeof(float) * vertices.size());
-
-	// Finally we notify the GPU the change.
-	glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(sizeof(float) * vertices.size()));
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-
-	auto stride = 0;
-	for (const auto [size, normalized] : layout) {
-		stride += static_cast<int>(size);
-	}
-	stride *= sizeof(float);
-	auto offset = 0;
-	for (unsigned int idx = 0; idx < layout.size(); ++idx) {
-		const auto [size, normalized] = layout[idx];
-		glVertexAttribPointer(
-			idx, static_cast<GLint>(size), GL_FLOAT, !normalized, stride,
-			reinterpret_cast<void*>(offset * sizeof(GLfloat))  // NOLINT(performance-no-int-to-ptr)
+	// A VAO of its own reads the same page of vertices and indices as the mesh, plus the instances
+	const auto& geometry = source->geometry;
+	const auto vao = _arena.createVertexArray(geometry);
+	glBindVertexArray(vao);
+	glBindVertexBuffer(
+		0, _arena.getVertexBuffer(geometry), 0,
+		static_cast<GLsizei>(vertexStride(_arena.getLayout(geometry)))
+	);
+	for (GLuint column = 0; column < 4; ++column) {
+		const auto location = INSTANCE_TRANSFORM_LOCATION + column;
+		glVertexAttribFormat(
+			location, 4, GL_FLOAT, GL_FALSE,
+			static_cast<GLuint>(offsetof(PackedInstance, transform) + column * 4 * sizeof(float))
 		);
-		glEnableVertexAttribArray(idx);
-		offset += static_cast<int>(size);
+		glVertexAttribBinding(location, INSTANCE_BINDING);
+		glEnableVertexAttribArray(location);
 	}
+	glVertexAttribFormat(INSTANCE_COLOR_LOCATION, 4, GL_UNSIGNED_BYTE, GL_TRUE, static_cast<GLuint>(offsetof(PackedInstance, color)));
+	glVertexAttribBinding(INSTANCE_COLOR_LOCATION, INSTANCE_BINDING);
+	glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+	glVertexBindingDivisor(INSTANCE_BINDING, 1);
+	glBindVertexArray(0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// every instanced mesh shares one program, so their draws stay in the same state bucket
+	static const auto program = Shader::createProgram(INSTANCED_VERT_SHADER_PATH, INSTANCED_FRAG_SHADER_PATH);
+
+	// No indirect commands, the elements are drawn one instanced call each. Until instances come in
+	// there is nothing to bound.
+	auto instanced = InstancedMesh{
+		std::make_unique<StreamBuffer>(std::max<std::size_t>(capacity * sizeof(PackedInstance), 1)),
+		capacity, 0, source->bounds, MeshBounds{}
+	};
+	const auto stats = _meshStats[getSlot(renderable)];
+	const auto instancedRenderable = storeMesh(
+		Mesh{ vao, program, source->elements, 0, {}, source->indexType, geometry, CommandAllocation{}, MeshBounds{} },
+		stats
+	);
+	_instancedMeshes.emplace(instancedRenderable, std::move(instanced));
 
-	_vertexBuffers.push_back(vbo);
+	return instancedRenderable;
 }
 
-void Engine::createIndexBuffer(const std::vector<Primitive>& primitives) {
-	std::size_t size = 0;
-	for (const auto& [_, indices] : primitives) {
-		size += indices.size();
+MeshBounds Engine::updateInstances(const Renderable renderable, const std::span<const Instance> instances) {
+	auto& [stream, capacity, count, bounds, instanceBounds] = _instancedMeshes.at(renderable);
+	if (instances.size() > capacity) {
+		throw std::invalid_argument("An instanced mesh cannot draw more instances than it was created for.");
 	}
 
-	auto jointIndices = std::vector<IndexType>{};
-	jointIndices.reserve(size);
-	for (const auto& [_, indices] : primitives) {
-		auto span = std::span(indices.data(), indices.size());
-		jointIndices.insert(jointIndices.end(), span.begin(), span.end());
+	const auto region = stream->map();
+	auto min = glm::vec3{ std::numeric_limits<float>::max() };
+	auto max = glm::vec3{ std::numeric_limits<float>::lowest() };
+	for (std::size_t i = 0; i < instances.size(); ++i) {
+		const auto& [transform, color] = instances[i];
+		auto packed = PackedInstance{};
+		std::memcpy(packed.transform.data(), value_ptr(transform), sizeof(packed.transform));
+		packed.color = glm::packUnorm4x8(color);
+		std::memcpy(region.data() + i * sizeof(PackedInstance), &packed, sizeof(packed));
+
+		// The sphere of the mesh, moved along and grown by the largest scale of the transform
+		const auto center = glm::vec3{ transform * glm::vec4{ bounds.center, 1.0f } };
+		const auto scale = std::max({
+			glm::length(glm::vec3{ transform[0] }),
+			glm::length(glm::vec3{ transform[1] }),
+			glm::length(glm::vec3{ transform[2] })
+		});
+		const auto extent = glm::vec3{ bounds.radius * scale };
+		min = glm::min(min, center - extent);
+		max = glm::max(max, center + extent);
 	}
+	count = instances.size();
 
-	GLuint ibo;
-	glGenBuffers(1, &ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-	glBufferData(
-		GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(IndexType) * jointIndices.size()),
-		jointIndices.data(), GL_STATIC_DRAW
+	// The VAO is not part of the renderer's bound state between frames, so rebinding it here is safe
+	glBindVertexArray(findMesh(renderable)->vao);
+	glBindVertexBuffer(
+		INSTANCE_BINDING, stream->getBuffer(), static_cast<GLintptr>(stream->getOffset()),
+		static_cast<GLsizei>(sizeof(PackedInstance))
 	);
+	glBindVertexArray(0);
 
-	_indexBuffers.push_back(ibo);
+	instanceBounds = instances.empty() ? MeshBounds{} : MeshBounds{ (min + max) * 0.5f, glm::length(max - min) * 0.5f, min, max };
+	_renderableManager.updateMeshBounds(renderable, instanceBounds);
+	return instanceBounds;
 }
 
-std::vector<Element> Engine::createElements(const std::vector<Primitive>& primitives) {
+Renderable Engine::loadDirect(const Drawable& drawable, const DrawableSize& size, const LoadOptions& options) {
+	const auto& [vertexCount, primitives] = size;
+	const auto layout = drawable.layout();
+
+	// Without ranges to split into, 16-bit indices need every vertex below the restart index
+	const auto shortIndices = options.shortIndices && vertexCount < MeshOptimizer::SHORT_RESTART_INDEX;
+	const auto indexType = static_cast<GLenum>(shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+	const auto indexSize = shortIndices ? sizeof(GLushort) : sizeof(GLuint);
+
+	std::size_t indexCount = 0;
+	for (const auto& primitive : primitives) {
+		indexCount += primitive.indexCount;
+	}
+
+	const auto geometry = _arena.allocate(layout, vertexCount, indexCount * indexSize);
+	auto bounds = MeshBounds{};
+	_arena.upload(geometry, [&](const auto vertexMemory, const auto indexMemory) {
+		auto vertices = VertexWriter{ vertexMemory, layout };
+		auto indices = IndexWriter{ indexMemory, indexType };
+		drawable.write(vertices, indices);
+		if (vertices.getCount() != vertexCount || indices.getCount() != indexCount) {
+			throw std::logic_error("The drawable wrote a different amount than it reported.");
+		}
+
+		// The vertices are gone once written, so the sphere simply encloses their box
+		const auto [minX, minY, minZ] = vertices.getMin();
+		const auto [maxX, maxY, maxZ] = vertices.getMax();
+		const auto min = glm::vec3{ minX, minY, minZ };
+		const auto max = glm::vec3{ maxX, maxY, maxZ };
+		bounds = MeshBounds{ (min + max) * 0.5f, glm::length(max - min) * 0.5f, min, max };
+	});
+
+	// Every primitive becomes an element of its own, the multi-draw call makes them cheap anyway
 	auto elements = std::vector<Element>{};
-	auto offset = 0;
+	elements.reserve(primitives.size());
+	auto offset = static_cast<int>(geometry.indexOffset / indexSize);
+	for (const auto& [topology, count] : primitives) {
+		elements.emplace_back(topology, count, offset, static_cast<GLint>(geometry.baseVertex), 0u);
+		offset += static_cast<int>(count);
+	}
+	auto [commands, batches] = createIndirectCommands(elements);
 
-	for (const auto& [topology, indices] : primitives) {
-		elements.emplace_back(topology, indices.size(), offset);
-		offset += static_cast<int>(indices.size());
+	auto stats = MeshStats{};
+	stats.indexType = indexType;
+
+	return storeMesh(
+		Mesh{
+			_arena.getVertexArray(geometry), drawable.shader, std::move(elements),
+			_arena.getCommandBuffer(commands), std::move(batches), indexType, geometry, commands, bounds
+		},
+		stats
+	);
+}
+
+Engine::PreparedGeometry Engine::prepareGeometry(const Drawable& drawable, const LoadOptions& options) {
+	auto vertices = drawable.vertices();
+	auto layout = drawable.layout();
+
+	auto stats = MeshStats{};
+	auto primitives = drawable.primitives();
+	if (options.stitch) {
+		auto [stitched, removed] = MeshOptimizer::stitch(primitives, options.primitiveRestart);
+		primitives = std::move(stitched);
+		stats.stitchedElements = removed;
+	}
+	if (options.optimize) {
+		auto [optimized, reordered, before, after, converted] = MeshOptimizer::optimize(
+			primitives, vertices, vertexComponents(layout), options.overdraw
+		);
+		primitives = std::move(optimized);
+		vertices = std::move(reordered);
+		stats.acmrBefore = before.acmr;
+		stats.acmrAfter = after.acmr;
+		stats.atvrBefore = before.atvr;
+		stats.atvrAfter = after.atvr;
+		stats.convertedToList = converted;
 	}
 
-	return elements;
+	// Pick the narrowest index type, splitting the mesh into ranges with their own base vertex if needed
+	auto ranges = std::vector<MeshOptimizer::IndexRange>{};
+	GLenum indexType = GL_UNSIGNED_INT;
+	if (auto shortRanges = options.shortIndices ? MeshOptimizer::splitShortRanges(primitives) : std::nullopt) {
+		ranges = std::move(*shortRanges);
+		indexType = GL_UNSIGNED_SHORT;
+	} else {
+		for (const auto& [topology, indices] : primitives) {
+			ranges.emplace_back(topology, indices, 0u);
+		}
+	}
+	stats.indexType = indexType;
+	stats.splitElements = ranges.size() - primitives.size();
+
+	return { std::move(vertices), std::move(layout), std::move(ranges), indexType, stats };
 }
 
+MeshBounds Engine::computeBounds(const std::vector<float>& vertices, const std::size_t components) {
+	const auto vertexCount = vertices.size() / components;
+	if (vertexCount == 0) {
+		return {};
+	}
 
-void Engine::render(const Renderable renderable, const Camera& camera) const {
-	glClearColor(_clearColor[0], _clearColor[1], _clearColor[2], _clearColor[3]);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	const auto position = [&](const std::size_t v) {
+		return glm::vec3{ vertices[v * components], vertices[v * components + 1], vertices[v * components + 2] };
+	};
 
-	// Compute MVP matrices
-	const auto model = glm::mat4(1.0f);
-	const auto view = camera.getViewMatrix();
-	const auto projection = camera.getProjection();
+	// Centered on the box around the positions, then grown to the farthest of them
+	auto min = position(0);
+	auto max = min;
+	for (std::size_t v = 1; v < vertexCount; ++v) {
+		min = glm::min(min, position(v));
+		max = glm::max(max, position(v));
+	}
+	const auto center = (min + max) * 0.5f;
 
-	if (renderable < _meshes.size()) {
-		// Specify which program to use first
-		const auto program = _meshes[renderable].shader;
-		glUseProgram(program);
+	auto radius = 0.0f;
+	for (std::size_t v = 0; v < vertexCount; ++v) {
+		radius = std::max(radius, glm::length(position(v) - center));
+	}
+	return { center, radius, min, max };
+}
 
-		// Set the model matrix
-		glUniformMatrix4fv(
-			glGetUniformLocation(program, "model"),
-			1, GL_FALSE, value_ptr(model)
-		);
+Renderable Engine::storeMesh(Mesh&& mesh, const MeshStats& stats) {
+	// Reuse the slot unloaded the longest ago, under a handle of the next generation
+	auto slot = static_cast<std::uint32_t>(_meshes.size());
+	if (_freeMeshSlots.size() > MIN_FREE_MESH_SLOTS) {
+		slot = _freeMeshSlots.front();
+		_freeMeshSlots.pop_front();
+		const auto generation = (_meshHandles[slot] >> MESH_SLOT_BITS) + 1;
+		_meshHandles[slot] = slot | generation << MESH_SLOT_BITS;
+	} else {
+		if (slot > MESH_SLOT_MASK) {
+			throw std::runtime_error("Ran out of mesh slots.");
+		}
+		_meshes.emplace_back();
+		_meshHandles.push_back(slot);
+		_meshStats.emplace_back();
+	}
+	_programs.insert(mesh.shader);
+	_meshes[slot].emplace(std::move(mesh));
+	_meshStats[slot] = stats;
 
-		// Set the view matrix
-		glUniformMatrix4fv(
-			glGetUniformLocation(program, "view"),
-			1, GL_FALSE, value_ptr(view)
-		);
+	return _meshHandles[slot];
+}
+
+const MeshBounds& Engine::getMeshBounds(const Renderable renderable) const {
+	if (const auto dynamic = _dynamicMeshes.find(renderable); dynamic != _dynamicMeshes.end()) {
+		return dynamic->second.bounds;
+	}
+	if (const auto instanced = _instancedMeshes.find(renderable); instanced != _instancedMeshes.end()) {
+		return instanced->second.instanceBounds;
+	}
+	return findMesh(renderable)->bounds;
+}
+
+const Mesh* Engine::findMesh(const Renderable renderable) const {
+	const auto slot = getSlot(renderable);
+	if (slot >= _meshes.size() || _meshHandles[slot] != renderable || !_meshes[slot]) {
+		return nullptr;
+	}
+	return &*_meshes[slot];
+}
+
+void Engine::unloadMesh(const Renderable renderable) {
+	if (!findMesh(renderable)) {
+		return;
+	}
+	auto& mesh = _meshes[getSlot(renderable)];
+
+	// Instanced meshes only own their VAO and instances, the geometry belongs to the mesh they draw
+	if (const auto instanced = _instancedMeshes.find(renderable); instanced != _instancedMeshes.end()) {
+		glDeleteVertexArrays(1, &mesh->vao);
+		_instancedMeshes.erase(instanced);
+		mesh.reset();
+		_freeMeshSlots.push_back(getSlot(renderable));
+		return;
+	}
+
+	// Coarser levels go along with the finest, which is the only renderable handed out
+	if (const auto chain = _lodChains.find(renderable); chain != _lodChains.end()) {
+		const auto levels = std::move(chain->second);
+		_lodChains.erase(chain);
+		for (const auto level : levels | std::views::drop(1)) {
+			unloadMesh(level);
+		}
+	}
+
+	if (const auto dynamic = _dynamicMeshes.find(renderable); dynamic != _dynamicMeshes.end()) {
+		glDeleteVertexArrays(1, &mesh->vao);
+		_dynamicMeshes.erase(dynamic);
+	}
+
+	_pickMeshes.erase(renderable);
+	_arena.free(mesh->geometry);
+	_arena.free(mesh->commands);
+	mesh.reset();
+	_freeMeshSlots.push_back(getSlot(renderable));
+}
+
+const MeshStats& Engine::getMeshStats(const Renderable renderable) const {
+	if (!findMesh(renderable)) {
+		throw std::invalid_argument(std::format("Renderable {} has no mesh loaded.\n", renderable));
+	}
+	return _meshStats[getSlot(renderable)];
+}
+
+std::optional<Engine::PickResult> Engine::pick(const View& view, const float x, const float y) {
+	const auto scene = view.getScene();
+	const auto camera = view.getCamera();
+	if (scene == nullptr || camera == nullptr) {
+		return std::nullopt;
+	}
+
+	const auto [origin, direction] = camera->getRay(x, y);
+	auto nearest = std::optional<PickResult>{};
+	scene->_bvh.raycast(origin, direction, std::numeric_limits<float>::max(), [&](const auto index, auto) {
+		const auto maxDistance = nearest ? nearest->distance : std::numeric_limits<float>::max();
+		const auto instance = _renderableManager.findInstance(scene->_entities[index]);
+		if (instance == RenderableManager::NONE) {
+			return maxDistance;
+		}
+		const auto renderable = _renderableManager._meshes[instance];
+		const auto pickMesh = getPickMesh(renderable);
+		if (pickMesh == nullptr) {
+			return maxDistance;
+		}
+
+		// Into the space of the vertices, leaving the direction unnormalized so distances stay those of the world
+		auto localOrigin = origin;
+		auto localDirection = direction;
+		if (const auto world = _transformManager.findWorldTransform(scene->_entities[index])) {
+			const auto inverse = glm::inverse(*world);
+			localOrigin = glm::vec3{ inverse * glm::vec4{ origin, 1.0f } };
+			localDirection = glm::vec3{ inverse * glm::vec4{ direction, 0.0f } };
+		}
+
+		const auto hit = pickMesh->bvh->intersect(localOrigin, localDirection, maxDistance);
+		if (!hit) {
+			return maxDistance;
+		}
+		const auto& starts = pickMesh->elementStarts;
+		const auto element = static_cast<std::size_t>(std::ranges::upper_bound(starts, hit->triangle) - starts.begin()) - 1;
+		nearest = PickResult{
+			scene->_entities[index], renderable, element, hit->triangle - starts[element],
+			origin + direction * hit->distance, hit->distance
+		};
+		return hit->distance;
+	});
+	return nearest;
+}
 
-		// Set the projection matrix
-		glUniformMatrix4fv(
-			glGetUniformLocation(program, "projection"), 
-			1, GL_FALSE, value_ptr(projection)
+const Engine::PickMesh* Engine::getPickMesh(const Renderable renderable) {
+	if (const auto it = _pickMeshes.find(renderable); it != _pickMeshes.end()) {
+		return &it->second;
+	}
+	const auto found = findMesh(renderable);
+	if (!found || _dynamicMeshes.contains(renderable) || _instancedMeshes.contains(renderable)) {
+		return nullptr;
+	}
+
+	// the vertices and indices only exist on the GPU once loaded, so read them back
+	const auto& mesh = *found;
+	const auto& geometry = mesh.geometry;
+	const auto& layout = _arena.getLayout(geometry);
+	const auto stride = vertexStride(layout);
+	auto vertexBytes = std::vector<std::byte>(geometry.vertexCount * stride);
+	auto indexBytes = std::vector<std::byte>(geometry.indexBytes);
+	_arena.download(geometry, vertexBytes, indexBytes);
+
+	// the position is always the first attribute
+	auto positions = std::vector<glm::vec3>(geometry.vertexCount);
+	for (std::size_t v = 0; v < positions.size(); ++v) {
+		auto position = std::array<float, 4>{};
+		unpackAttribute(vertexBytes.data() + v * stride, layout.front(), position.data());
+		positions[v] = glm::vec3{ position[0], position[1], position[2] };
+	}
+
+	const auto shortIndices = mesh.indexType == GL_UNSIGNED_SHORT;
+	const auto indexSize = shortIndices ? sizeof(GLushort) : sizeof(GLuint);
+	const auto restartIndex = shortIndices ? MeshOptimizer::SHORT_RESTART_INDEX : MeshOptimizer::RESTART_INDEX;
+	const auto readIndex = [&](const std::size_t i) -> std::uint32_t {
+		if (shortIndices) {
+			GLushort index;
+			std::memcpy(&index, indexBytes.data() + i * indexSize, sizeof(index));
+			return index;
+		}
+		GLuint index;
+		std::memcpy(&index, indexBytes.data() + i * indexSize, sizeof(index));
+		return index;
+	};
+
+	// strips and fans are unrolled into a list, restarting wherever the restart index shows up
+	auto triangles = std::vector<std::uint32_t>{};
+	auto elementStarts = std::vector<std::uint32_t>{};
+	elementStarts.reserve(mesh.elements.size());
+	for (const auto& element : mesh.elements) {
+		elementStarts.push_back(static_cast<std::uint32_t>(triangles.size() / 3));
+
+		const auto first = static_cast<std::size_t>(element.offset) - geometry.indexOffset / indexSize;
+		const auto vertexOffset = static_cast<std::size_t>(element.baseVertex) - geometry.baseVertex;
+		std::array<std::uint32_t, 3> window{};
+		std::size_t run = 0;
+		for (std::size_t i = 0; i < element.count; ++i) {
+			const auto index = readIndex(first + i);
+			if (index == restartIndex) {
+				run = 0;
+				continue;
+			}
+			const auto vertex = static_cast<std::uint32_t>(index + vertexOffset);
+
+			switch (element.topology) {
+			case GL_TRIANGLES:
+				window[run % 3] = vertex;
+				if (run % 3 == 2) {
+					triangles.insert(triangles.end(), window.begin(), window.end());
+				}
+				break;
+			case GL_TRIANGLE_STRIP:
+				if (run >= 2) {
+					// every other triangle of a strip winds the other way
+					const auto a = run % 2 == 0 ? window[0] : window[1];
+					const auto b = run % 2 == 0 ? window[1] : window[0];
+					triangles.insert(triangles.end(), { a, b, vertex });
+				}
+				window[0] = window[1];
+				window[1] = vertex;
+				break;
+			case GL_TRIANGLE_FAN:
+				if (run == 0) {
+					window[0] = vertex;
+				} else if (run >= 2) {
+					triangles.insert(triangles.end(), { window[0], window[1], vertex });
+				}
+				window[1] = vertex;
+				break;
+			default:
+				// points and lines have no surface to hit
+				break;
+			}
+			++run;
+		}
+	}
+
+	const auto [it, _] = _pickMeshes.emplace(
+		renderable, PickMesh{ std::make_unique<TriangleBvh>(positions, triangles), std::move(elementStarts) }
+	);
+	return &it->second;
+}
+
+std::vector<std::byte> Engine::joinIndices(const std::vector<MeshOptimizer::IndexRange>& ranges, const GLenum indexType) {
+	std::size_t size = 0;
+	for (const auto& range : ranges) {
+		size += range.indices.size();
+	}
+
+	// Joins the ranges into indices of the given width, moving the restart index along
+	const auto join = [&]<typename T>(T restartIndex) {
+		auto jointIndices = std::vector<std::byte>(size * sizeof(T));
+		auto destination = reinterpret_cast<T*>(jointIndices.data());
+		for (const auto& range : ranges) {
+			for (const auto index : range.indices) {
+				*destination++ = index == MeshOptimizer::RESTART_INDEX ? restartIndex : static_cast<T>(index);
+			}
+		}
+		return jointIndices;
+	};
+
+	return indexType == GL_UNSIGNED_SHORT
+		? join(static_cast<GLushort>(MeshOptimizer::SHORT_RESTART_INDEX))
+		: join(static_cast<GLuint>(MeshOptimizer::RESTART_INDEX));
+}
+
+std::vector<Element> Engine::createElements(
+	const std::vector<MeshOptimizer::IndexRange>& ranges,
+	const std::size_t firstIndex,
+	const std::size_t baseVertex
+) {
+	auto elements = std::vector<Element>{};
+	auto offset = static_cast<int>(firstIndex);
+
+	for (const auto& [topology, indices, rangeBaseVertex] : ranges) {
+		elements.emplace_back(
+			topology, indices.size(), offset,
+			static_cast<GLint>(baseVertex + rangeBaseVertex), 0u
 		);
+		offset += static_cast<int>(indices.size());
+	}
 
-		// VAO will be linked to the currently used program
-		glBindVertexArray(_meshes[renderable].vao);
-		
-		for (unsigned int i = 0; i < _meshes[renderable].elements.size(); ++i) {
-			const auto [topology, count, offset, texture] = _meshes[renderable].elements[i];
+	return elements;
+}
 
-			// Bind the texture before the draw call
-			glActiveTexture(GL_TEXTURE0 + i);
-			glBindTexture(GL_TEXTURE_2D, texture);
+std::pair<CommandAllocation, std::vector<DrawBatch>> Engine::createIndirectCommands(const std::vector<Element>& elements) {
+	// Group the elements by the state a multi-draw call cannot vary: the topology and the texture.
+	// The base instance carries the element index so per-element data stays addressable.
+	auto order = std::vector<std::size_t>(elements.size());
+	for (std::size_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	std::ranges::stable_sort(order, [&elements](const auto a, const auto b) {
+		return std::tie(elements[a].topology, elements[a].texture) < std::tie(elements[b].topology, elements[b].texture);
+	});
 
-			glDrawElements(
-				topology, static_cast<GLsizei>(count), GL_UNSIGNED_INT,
-				reinterpret_cast<void*>(offset * sizeof(GLuint)) // NOLINT(performance-no-int-to-ptr)
-			);
+	auto commands = std::vector<DrawElementsIndirectCommand>{};
+	commands.reserve(elements.size());
+	auto groups = std::vector<std::pair<std::size_t, std::size_t>>{};	// first command and count of each batch
+	for (std::size_t i = 0; i < order.size();) {
+		const auto& first = elements[order[i]];
+		auto j = i;
+		for (; j < order.size() && elements[order[j]].topology == first.topology && elements[order[j]].texture == first.texture; ++j) {
+			const auto& element = elements[order[j]];
+			commands.push_back(DrawElementsIndirectCommand{
+				static_cast<GLuint>(element.count), 1, static_cast<GLuint>(element.offset),
+				element.baseVertex, static_cast<GLuint>(order[j])
+			});
 		}
-		
-		glBindVertexArray(0);
+		groups.emplace_back(i, j - i);
+		i = j;
 	}
+
+	const auto allocation = _arena.allocateCommands(commands);
+
+	auto batches = std::vector<DrawBatch>{};
+	for (const auto& [firstCommand, count] : groups) {
+		const auto& first = elements[order[firstCommand]];
+		batches.emplace_back(
+			first.topology, first.texture, static_cast<GLsizei>(count),
+			(allocation.offset + firstCommand) * sizeof(DrawElementsIndirectCommand)
+		);
+	}
+
+	return { allocation, batches };
 }
 
+
 void Engine::destroyCamera(const Entity entity) {
 	_cameras.erase(entity);
 }
 
 void Engine::destroy() {
-	for (const auto& [vao, shader, elements] : _meshes) {
-		glDeleteVertexArrays(1, &vao);
-		glDeleteProgram(shader);
+	// destroy the programs of every mesh ever loaded
+	for (const auto program : _programs) {
+		glDeleteProgram(program);
 	}
 
-	// destroy remaining vertex buffers
-	for (const auto buffer : _vertexBuffers) {
-		glDeleteBuffers(1, &buffer);
+	// destroy the streamed vertices of dynamic meshes and instances, then the buffers holding all other geometry
+	for (const auto& [renderable, _] : _dynamicMeshes) {
+		glDeleteVertexArrays(1, &findMesh(renderable)->vao);
 	}
-
-	// destroy remaining index buffers
-	for (const auto buffer : _indexBuffers) {
-		glDeleteBuffers(1, &buffer);
+	_dynamicMeshes.clear();
+	for (const auto& [renderable, _] : _instancedMeshes) {
+		glDeleteVertexArrays(1, &findMesh(renderable)->vao);
 	}
+	_instancedMeshes.clear();
+	_pickMeshes.clear();
+	_arena.destroy();
 
 	// destroy remaining camera resources
 	for (auto [_, ptr] : _cameras) {
 		delete ptr;
 	}
 
-	// destroy entity manager
-	delete _entityManager;
+	// destroy remaining renderers, views and scenes
+	for (const auto renderer : _renderers) {
+		delete renderer;
+	}
+	for (const auto view : _views) {
+		delete view;
+	}
+	for (const auto scene : _scenes) {
+		delete scene;
+	}
 }
 
 
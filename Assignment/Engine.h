@@ -3,17 +3,31 @@
 #include <glad/glad.h>
 #include <vector>
 #include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <span>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
+#include <optional>
+#include <utility>
 
+#include "BufferArena.h"
 #include "Context.h"
 #include "EntityManager.h"
 #include "Camera.h"
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "RenderableManager.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "StreamBuffer.h"
+#include "TransformManager.h"
+#include "TriangleBvh.h"
+#include "View.h"
 #include "drawable/Drawable.h"
 
-using Renderable   = unsigned int;
-
 class Engine {
 public:
 	enum class PolygonMode {
@@ -21,45 +35,258 @@ public:
 		FILL = GL_FILL
 	};
 
+	struct LoadOptions {
+		// Merge the primitives sharing a topology into a single element.
+		bool stitch;
+
+		// Join merged strips and fans with the restart index instead of degenerate triangles.
+		bool primitiveRestart;
+
+		// Reorder triangles and vertices for the post-transform cache and vertex fetch.
+		bool optimize;
+
+		// Also sort clusters of triangles to reduce overdraw, at a small cost in cache efficiency.
+		bool overdraw;
+
+		// Use 16-bit indices whenever the mesh, or ranges of it, address few enough vertices.
+		bool shortIndices;
+	};
+
+	static constexpr auto DEFAULT_LOAD_OPTIONS = LoadOptions{
+		.stitch = true, .primitiveRestart = true, .optimize = true, .overdraw = false, .shortIndices = true
+	};
+
+	// Without stitching or optimizing, drawables that report their size write themselves straight
+	// into mapped upload memory, and the mesh never exists anywhere else in CPU memory. The defaults
+	// keep the copying path, since the reordering it allows pays off on every frame the mesh is drawn:
+	// a grid of row strips transforms about 1.0 vertex per triangle as written and about 0.68 once
+	// optimized, so skipping it costs close to half again as many vertex shader runs. Only the copying
+	// path measures what getMeshStats reports. These suit large or on-the-fly meshes, such as height
+	// fields and terrain chunks, where load time and peak memory matter more.
+	static constexpr auto DIRECT_LOAD_OPTIONS = LoadOptions{
+		.stitch = false, .primitiveRestart = true, .optimize = false, .overdraw = false, .shortIndices = true
+	};
+
 	static std::unique_ptr<Engine> create(const Context& context);
 
+	// The process-wide entity manager, which outlives every engine and is never the engine's to release.
 	[[nodiscard]] EntityManager* getEntityManager() const;
 
+	[[nodiscard]] TransformManager* getTransformManager();
+
+	[[nodiscard]] RenderableManager* getRenderableManager();
+
+	// Brings the world transforms up to date with what was set since the last call, moving the bounds of
+	// the entities that moved in every scene along. Meant to run once per frame, before rendering.
+	void updateTransforms();
+
 	Camera* createCamera(Entity entity, float initialRatio = 1.0f);
 
 	void destroyCamera(Entity entity);
 
-	void setClearColor(float r, float g, float b, float a);
+	Renderer* createRenderer();
+
+	void destroyRenderer(const Renderer* renderer);
+
+	Scene* createScene();
+
+	void destroyScene(const Scene* scene);
+
+	View* createView();
+
+	void destroyView(const View* view);
 
 	static void setPolygonMode(PolygonMode mode);
 
-	[[nodiscard]] Renderable loadMesh(const Drawable& drawable);
+	// Loads the drawable along with its coarser levels of detail, if it has any, all behind one renderable.
+	[[nodiscard]] Renderable loadMesh(const Drawable& drawable, const LoadOptions& options = DEFAULT_LOAD_OPTIONS);
+
+	// Loads a mesh whose vertices are rewritten every frame. The vertices are never reordered,
+	// and every update must provide at most as many as the drawable produced here.
+	[[nodiscard]] Renderable createDynamicMesh(const Drawable& drawable, const LoadOptions& options = DEFAULT_LOAD_OPTIONS);
+
+	// Streams new vertices for a dynamic mesh, in the layout of its drawable. The frames in flight
+	// keep reading their own copy, so this only blocks if the CPU runs more than two frames ahead.
+	void updateDynamicMesh(Renderable renderable, const std::vector<float>& vertices);
+
+	// Hands the next region of a dynamic mesh to the writer, already packed in the layout of its drawable.
+	// A region keeps what was written to it a full ring ago, starting with the vertices the drawable
+	// produced at creation, so the writer only needs to touch the attributes that change every frame.
+	// The writer returns bounds around all the vertices of the region, which the entities drawing the mesh
+	// take on in every scene, unless they were given bounds of their own.
+	void updateDynamicMesh(Renderable renderable, const std::function<MeshBounds(std::span<std::byte>)>& writer);
+
+	struct Instance {
+		glm::mat4 transform;
+		glm::vec4 color;	// multiplies the color of the vertices
+	};
+
+	// Creates a renderable drawing the mesh once per instance, in as many calls as the mesh has elements
+	// however many instances there are. It shares the geometry of the mesh, which must outlive it, and
+	// draws with the instanced program, reading positions and colors the way baked color drawables lay them out.
+	[[nodiscard]] Renderable createInstancedMesh(Renderable renderable, std::size_t capacity);
+
+	// Streams the instances of an instanced mesh, at most as many as its capacity, the way dynamic meshes
+	// stream their vertices. Returns the bounds around all of them, which the entities drawing the renderable
+	// take on in every scene, unless they were given bounds of their own.
+	MeshBounds updateInstances(Renderable renderable, std::span<const Instance> instances);
 
-	void render(Renderable renderable, const Camera& camera) const;
+	// Releases the arena ranges of a mesh. Its renderable stops resolving, even once a later load reuses its slot.
+	void unloadMesh(Renderable renderable);
+
+	[[nodiscard]] const MeshStats& getMeshStats(Renderable renderable) const;
+
+	struct PickResult {
+		Entity entity;
+		Renderable renderable;
+		std::size_t element;		// into the elements of the mesh
+		std::uint32_t triangle;		// within the element
+		glm::vec3 point;
+		float distance;				// from the near plane
+	};
+
+	// The nearest surface of the view's scene under the point, given in normalized device coordinates.
+	// The triangles of a mesh are read back from the GPU and indexed the first time a ray reaches its
+	// bounds, every pick after that only walks the hierarchies. Dynamic and instanced meshes are not
+	// picked, as what they draw may move every frame.
+	[[nodiscard]] std::optional<PickResult> pick(const View& view, float x, float y);
 
 	void destroy();
 
+	friend class Renderer;
+
+	friend class RenderableManager;
+
+	friend class Scene;
+
+	friend class TransformManager;
+
 private:
 	explicit Engine(const Context& context);
 
-	EntityManager* _entityManager{ EntityManager::get() };
+	TransformManager _transformManager{ *this };
 
-	std::vector<Mesh> _meshes{};
+	RenderableManager _renderableManager{ *this };
 
-	std::vector<GLuint> _vertexBuffers{};
+	// By slot, the handle each slot was last handed out as beside it.
+	std::vector<std::optional<Mesh>> _meshes{};
+	std::vector<Renderable> _meshHandles{};
 
-	std::vector<GLuint> _indexBuffers{};
+	std::vector<MeshStats> _meshStats{};
 
-	std::array<float, 4> _clearColor{ 0.0f, 0.0f, 0.0f, 1.0f };
+	std::deque<std::uint32_t> _freeMeshSlots{};
 
-	void createVertexBuffer(const std::vector<float>& vertices, const std::vector<GenericAttribute>& layout);
+	static constexpr auto MESH_SLOT_BITS = 20;
+	static constexpr auto MESH_SLOT_MASK = (1u << MESH_SLOT_BITS) - 1;
 
-	void createIndexBuffer(const std::vector<Primitive>& primitives);
+	// Slots only come back once this many wait in the queue, as with entities, so a slot goes through
+	// all its generations only after a great many unloads.
+	static constexpr std::size_t MIN_FREE_MESH_SLOTS = 1024;
 
-	static [[nodiscard]] std::vector<Element> createElements(const std::vector<Primitive>& primitives);
+	static constexpr std::uint32_t getSlot(const Renderable renderable) {
+		return renderable & MESH_SLOT_MASK;
+	}
+
+	// Nullptr for handles whose mesh was unloaded, whatever their slot holds now.
+	[[nodiscard]] const Mesh* findMesh(Renderable renderable) const;
+
+	// The bounds of what the mesh draws now, which for dynamic meshes are those of their latest vertices
+	// and for instanced meshes those around their latest instances.
+	[[nodiscard]] const MeshBounds& getMeshBounds(Renderable renderable) const;
+
+	std::unordered_set<GLuint> _programs{};
+
+	BufferArena _arena{};
+
+	struct DynamicMesh {
+		std::unique_ptr<StreamBuffer> stream;
+		std::vector<GenericAttribute> layout;
+		std::size_t vertexCount;
+		MeshBounds bounds;	// of the vertices last written
+	};
+
+	std::unordered_map<Renderable, DynamicMesh> _dynamicMeshes{};
+
+	// The instances as the instanced program reads them, the color quantized to a byte per channel.
+	struct PackedInstance {
+		std::array<float, 16> transform;
+		std::uint32_t color;
+	};
+
+	struct InstancedMesh {
+		std::unique_ptr<StreamBuffer> stream;
+		std::size_t capacity;
+		std::size_t count;
+		MeshBounds bounds;			// of the mesh drawn, in its own space
+		MeshBounds instanceBounds;	// around every instance as of the last update, empty until then
+	};
+
+	std::unordered_map<Renderable, InstancedMesh> _instancedMeshes{};
+
+	static constexpr auto INSTANCED_VERT_SHADER_PATH = "shaders/instanced.vert";
+
+	static constexpr auto INSTANCED_FRAG_SHADER_PATH = "shaders/baked.frag";
+
+	// Past any attribute a drawable lays out, and bound to a buffer of their own advancing once per instance.
+	static constexpr GLuint INSTANCE_BINDING = 1;
+	static constexpr GLuint INSTANCE_TRANSFORM_LOCATION = 8;	// a column per location
+	static constexpr GLuint INSTANCE_COLOR_LOCATION = 12;
+
+	// The levels of detail of a mesh, from the finest, keyed by the finest.
+	std::unordered_map<Renderable, std::vector<Renderable>> _lodChains{};
+
+	// The triangles of a mesh, indexed for picking, with the first triangle of each of its elements.
+	struct PickMesh {
+		std::unique_ptr<TriangleBvh> bvh;
+		std::vector<std::uint32_t> elementStarts;
+	};
+
+	// Built on first use, since most meshes are never picked.
+	std::unordered_map<Renderable, PickMesh> _pickMeshes{};
+
+	// Nullptr for the meshes that cannot be picked.
+	[[nodiscard]] const PickMesh* getPickMesh(Renderable renderable);
+
+	// What the load-time passes leave of a drawable, ready to be packed.
+	struct PreparedGeometry {
+		std::vector<float> vertices;
+		std::vector<GenericAttribute> layout;
+		std::vector<MeshOptimizer::IndexRange> ranges;
+		GLenum indexType;
+		MeshStats stats;
+	};
+
+	static [[nodiscard]] PreparedGeometry prepareGeometry(const Drawable& drawable, const LoadOptions& options);
+
+	[[nodiscard]] Renderable loadLevel(const Drawable& drawable, const LoadOptions& options);
+
+	static [[nodiscard]] MeshBounds computeBounds(const std::vector<float>& vertices, std::size_t components);
+
+	[[nodiscard]] Renderable loadDirect(const Drawable& drawable, const DrawableSize& size, const LoadOptions& options);
+
+	Renderable storeMesh(Mesh&& mesh, const MeshStats& stats);
+
+	static [[nodiscard]] std::vector<std::byte> joinIndices(const std::vector<MeshOptimizer::IndexRange>& ranges, GLenum indexType);
+
+	static [[nodiscard]] std::vector<Element> createElements(
+		const std::vector<MeshOptimizer::IndexRange>& ranges,
+		std::size_t firstIndex,
+		std::size_t baseVertex
+	);
+
+	[[nodiscard]] std::pair<CommandAllocation, std::vector<DrawBatch>> createIndirectCommands(const std::vector<Element>& elements);
 
 	std::unordered_map<Entity, Camera*> _cameras{};
 
+	std::vector<Renderer*> _renderers{};
+
+	std::vector<Scene*> _scenes{};
+
+	std::vector<View*> _views{};
+
+	template<typename T>
+	static void destroyResource(std::vector<T*>& resources, const T* resource);
+
 	class Factory {
 	public:
 		std::unique_ptr<Engine> operator()(const Context& context) const;
@@ -4,26 +4,77 @@
 #include "EntityManager.h"
 
 EntityManager* EntityManager::get() {
-	if (!_instance) {
-		_instance = new EntityManager{};
-	}
-	return _instance;
+	// Initialized exactly once even when the first calls come from several threads at the same time
+	static auto instance = EntityManager{};
+	return &instance;
 }
 
+EntityManager::EntityManager() : _generations{ std::make_unique<std::atomic<std::uint16_t>[]>(std::size_t{ 1 } << INDEX_BITS) } {}
 
 Entity EntityManager::create() {
-	Entity id;
-	do {
-		id = _next++;
-	} while (_discardedEntities.contains(id));
-	return id;
+	const auto lock = std::scoped_lock{ _mutex };
+	return createLocked();
+}
+
+void EntityManager::create(const std::span<Entity> entities) {
+	const auto lock = std::scoped_lock{ _mutex };
+	for (auto& entity : entities) {
+		entity = createLocked();
+	}
 }
 
 void EntityManager::discard(const Entity entity) {
-	if (entity >= _next) {
+	const auto lock = std::scoped_lock{ _mutex };
+	if (!isAlive(entity)) {
 		throw std::invalid_argument(std::format("Entity {} is invalid.\n", entity));
 	}
-	_discardedEntities.insert(entity);
+	discardLocked(entity);
+}
+
+void EntityManager::discard(const std::span<const Entity> entities) {
+	const auto lock = std::scoped_lock{ _mutex };
+	for (const auto entity : entities) {
+		if (!isAlive(entity)) {
+			throw std::invalid_argument(std::format("Entity {} is invalid.\n", entity));
+		}
+	}
+	// a duplicate in the batch is no longer alive by the time it comes up again
+	for (const auto entity : entities) {
+		if (isAlive(entity)) {
+			discardLocked(entity);
+		}
+	}
+}
+
+bool EntityManager::isAlive(const Entity entity) const {
+	const auto index = getIndex(entity);
+	return index < _nextIndex.load(std::memory_order_acquire)
+		&& _generations[index].load(std::memory_order_relaxed) == getGeneration(entity);
+}
+
+std::size_t EntityManager::getAliveCount() const {
+	const auto lock = std::scoped_lock{ _mutex };
+	return _nextIndex.load(std::memory_order_relaxed) - _freeIndices.size();
+}
+
+Entity EntityManager::createLocked() {
+	// the queue gives up its slots early once no fresh one is left
+	auto index = _nextIndex.load(std::memory_order_relaxed);
+	if (_freeIndices.size() >= MIN_FREE_INDICES || (index > INDEX_MASK && !_freeIndices.empty())) {
+		index = _freeIndices.front();
+		_freeIndices.pop_front();
+	} else if (index > INDEX_MASK) {
+		throw std::length_error("Every entity slot is in use.\n");
+	} else {
+		_nextIndex.store(index + 1, std::memory_order_release);
+	}
+	return static_cast<Entity>(_generations[index].load(std::memory_order_relaxed)) << INDEX_BITS | index;
+}
+
+void EntityManager::discardLocked(const Entity entity) {
+	const auto index = getIndex(entity);
+	_generations[index].store(static_cast<std::uint16_t>((getGeneration(entity) + 1) & GENERATION_MASK), std::memory_order_relaxed);
+	_freeIndices.push_back(index);
 }
 
 Entity EntityResource::getEntity() const {
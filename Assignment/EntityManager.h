@@ -1,24 +1,71 @@
 #pragma once
 
-#include <set>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
 
-using Entity = int;
+// An index into the slots of the entity manager in the low bits, and the generation of the slot in the
+// high bits, so a handle kept past the discard of its entity no longer matches the slot once it is reused.
+using Entity = std::uint32_t;
 
+// Hands out entities in O(1), recycling the slots of discarded ones. Creating and discarding are safe to
+// call from any thread, the batch versions taking the lock once for the whole batch.
 class EntityManager {
 public:
 	static EntityManager* get();
 
 	Entity create();
 
+	// Fills the span with new entities.
+	void create(std::span<Entity> entities);
+
 	void discard(Entity entity);
+
+	// Discards all of the entities, or none of them if any is not alive.
+	void discard(std::span<const Entity> entities);
+
+	// Whether the entity was created and not discarded since. Never waits on the lock.
+	[[nodiscard]] bool isAlive(Entity entity) const;
+
+	[[nodiscard]] std::size_t getAliveCount() const;
+
+	static constexpr auto INDEX_BITS = 20;
+	static constexpr auto GENERATION_BITS = 12;
+	static constexpr auto INDEX_MASK = (1u << INDEX_BITS) - 1;
+	static constexpr auto GENERATION_MASK = (1u << GENERATION_BITS) - 1;
+
+	static constexpr std::uint32_t getIndex(const Entity entity) {
+		return entity & INDEX_MASK;
+	}
+
+	static constexpr std::uint32_t getGeneration(const Entity entity) {
+		return (entity >> INDEX_BITS) & GENERATION_MASK;
+	}
+
 private:
-	EntityManager() = default;
+	EntityManager();
+
+	[[nodiscard]] Entity createLocked();
+
+	void discardLocked(Entity entity);
+
+	// Slots only come back once this many wait in the queue, so the generation of a slot wraps around
+	// only after millions of discards rather than a few thousand.
+	static constexpr std::size_t MIN_FREE_INDICES = 1024;
+
+	mutable std::mutex _mutex{};
 
-	Entity _next{ 0 };
+	// Every slot up front, so checking an entity never races with the array growing.
+	std::unique_ptr<std::atomic<std::uint16_t>[]> _generations;
 
-	std::set<Entity> _discardedEntities{};
+	// How many slots were ever handed out, those past it have no entity yet.
+	std::atomic<std::uint32_t> _nextIndex{ 0 };
 
-	inline static EntityManager* _instance{ nullptr };
+	std::deque<std::uint32_t> _freeIndices{};
 };
 
 class EntityResource {
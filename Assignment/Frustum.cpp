@@ -0,0 +1,101 @@
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+	// each plane is the last row of the matrix plus or minus one of the others
+	const auto row = [&](const int r) {
+		return glm::vec4{ viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r] };
+	};
+	_planes = {
+		row(3) + row(0), row(3) - row(0),
+		row(3) + row(1), row(3) - row(1),
+		row(3) + row(2), row(3) - row(2)
+	};
+	for (auto& plane : _planes) {
+		plane /= glm::length(glm::vec3{ plane });
+	}
+}
+
+Frustum::Containment Frustum::classify(const glm::vec3& min, const glm::vec3& max) const {
+	auto containment = Containment::INSIDE;
+	for (const auto& plane : _planes) {
+		const auto normal = glm::vec3{ plane };
+		const auto furthest = glm::vec3{
+			plane.x >= 0.0f ? max.x : min.x,
+			plane.y >= 0.0f ? max.y : min.y,
+			plane.z >= 0.0f ? max.z : min.z
+		};
+		if (glm::dot(normal, furthest) + plane.w < 0.0f) {
+			return Containment::OUTSIDE;
+		}
+
+		// the nearest corner behind the plane means the box straddles it
+		const auto nearest = min + max - furthest;
+		if (glm::dot(normal, nearest) + plane.w < 0.0f) {
+			containment = Containment::INTERSECTS;
+		}
+	}
+	return containment;
+}
+
+bool Frustum::intersects(const glm::vec3& min, const glm::vec3& max) const {
+	// the box is out as soon as its corner furthest along some plane's normal is behind it
+	return std::ranges::all_of(_planes, [&](const auto& plane) {
+		const auto corner = glm::vec3{
+			plane.x >= 0.0f ? max.x : min.x,
+			plane.y >= 0.0f ? max.y : min.y,
+			plane.z >= 0.0f ? max.z : min.z
+		};
+		return glm::dot(glm::vec3{ plane }, corner) + plane.w >= 0.0f;
+	});
+}
+
+bool Frustum::intersects(const glm::vec3& center, const float radius) const {
+	return std::ranges::all_of(_planes, [&](const auto& plane) {
+		return glm::dot(glm::vec3{ plane }, center) + plane.w >= -radius;
+	});
+}
+
+void Frustum::intersects(
+	const std::span<const float> xs,
+	const std::span<const float> ys,
+	const std::span<const float> zs,
+	const std::span<const float> radii,
+	const std::span<std::uint8_t> visible
+) const {
+	const auto count = visible.size();
+	std::size_t i = 0;
+
+#ifdef FRUSTUM_SSE
+	// four spheres against one plane at a time, the planes broadcast across the lanes
+	for (; i + 4 <= count; i += 4) {
+		const auto x = _mm_loadu_ps(xs.data() + i);
+		const auto y = _mm_loadu_ps(ys.data() + i);
+		const auto z = _mm_loadu_ps(zs.data() + i);
+		const auto r = _mm_loadu_ps(radii.data() + i);
+
+		auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const auto& plane : _planes) {
+			auto distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+			distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), _mm_setzero_ps()));
+		}
+
+		const auto mask = _mm_movemask_ps(inside);
+		for (auto lane = 0; lane < 4; ++lane) {
+			visible[i + lane] = static_cast<std::uint8_t>(mask >> lane & 1);
+		}
+	}
+#endif
+
+	for (; i < count; ++i) {
+		visible[i] = intersects(glm::vec3{ xs[i], ys[i], zs[i] }, radii[i]) ? 1 : 0;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+// The six planes bounding what a view projection sees, facing inwards and normalized,
+// so the signed distance of a point to each is a single dot product.
+class Frustum {
+public:
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	enum class Containment {
+		OUTSIDE,
+		INTERSECTS,
+		INSIDE
+	};
+
+	// Where the box lies, so whole hierarchies inside the frustum can skip testing what they hold.
+	[[nodiscard]] Containment classify(const glm::vec3& min, const glm::vec3& max) const;
+
+	// Whether the box is inside or crosses the frustum.
+	[[nodiscard]] bool intersects(const glm::vec3& min, const glm::vec3& max) const;
+
+	// Whether the sphere is inside or crosses the frustum.
+	[[nodiscard]] bool intersects(const glm::vec3& center, float radius) const;
+
+	// Tests a whole batch of spheres, given as one array per component, writing 1 into visible for those
+	// inside or crossing the frustum and 0 for the rest. Runs four spheres at a time where SSE is available.
+	void intersects(
+		std::span<const float> xs,
+		std::span<const float> ys,
+		std::span<const float> zs,
+		std::span<const float> radii,
+		std::span<std::uint8_t> visible
+	) const;
+
+private:
+	std::array<glm::vec4, 6> _planes{};
+};
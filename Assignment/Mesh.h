@@ -1,16 +1,83 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// The slot of a mesh in the engine in the low bits, and how many meshes the slot held before it in the
+// high bits, so a handle kept past the unload of its mesh never reaches whatever takes the slot next.
+using Renderable   = unsigned int;
 
 struct Element {
 	const int topology;
 	const std::size_t count;
-	const int offset;
+	const int offset;		// in indices of the mesh index type
+	const GLint baseVertex;
+	const GLuint texture;
+};
+
+// Layout mandated by glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// A run of indirect commands sharing the state of a single multi-draw call.
+struct DrawBatch {
+	const int topology;
 	const GLuint texture;
+	const GLsizei drawCount;
+	const std::size_t offset;	// in bytes, into the indirect buffer
+};
+
+// What the load-time passes did to a mesh.
+struct MeshStats {
+	std::size_t stitchedElements{ 0 };	// elements merged away by stitching
+	float acmrBefore{ 0.0f };			// vertices transformed per triangle
+	float acmrAfter{ 0.0f };
+	float atvrBefore{ 0.0f };			// vertices transformed per unique vertex
+	float atvrAfter{ 0.0f };
+	bool convertedToList{ false };		// strips and fans were turned into a triangle list
+	GLenum indexType{ GL_UNSIGNED_INT };
+	std::size_t splitElements{ 0 };		// elements added to fit 16-bit index ranges
+};
+
+// Where the vertices and indices of a mesh live in the buffer arena.
+struct GeometryAllocation {
+	std::size_t page;
+	std::size_t baseVertex;		// in vertices
+	std::size_t vertexCount;
+	std::size_t indexOffset;	// in bytes
+	std::size_t indexBytes;
+};
+
+// Where the indirect commands of a mesh live in the buffer arena.
+struct CommandAllocation {
+	std::size_t page;
+	std::size_t offset;			// in commands
+	std::size_t count;
+};
+
+// The extent of a mesh in its own space, as a sphere for quick tests and a box for tight ones.
+struct MeshBounds {
+	glm::vec3 center{ 0.0f };
+	float radius{ 0.0f };
+	glm::vec3 min{ 0.0f };
+	glm::vec3 max{ 0.0f };
 };
 
 struct Mesh {
 	const GLuint vao;
 	const GLuint shader;
-	const std::vector<Element> elements;
+	const std::vector<Element> elements;	// offsets and base vertices are absolute in the arena page, except
+											// the base vertices of dynamic meshes, relative to their stream region
+	const GLuint indirectBuffer;
+	const std::vector<DrawBatch> batches;
+	const GLenum indexType;
+	const GeometryAllocation geometry;
+	const CommandAllocation commands;
+	const MeshBounds bounds;				// as loaded, the engine keeps those of dynamic and instanced meshes up to date
 };
@@ -0,0 +1,524 @@
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+#include "MeshOptimizer.h"
+
+MeshOptimizer::StitchResult MeshOptimizer::stitch(const std::vector<Primitive>& primitives, const bool primitiveRestart) {
+	// Topologies in order of first appearance, so the draw order stays stable
+	auto topologies = std::vector<int>{};
+	for (const auto& [topology, _] : primitives) {
+		if (std::ranges::find(topologies, topology) == topologies.end()) {
+			topologies.push_back(topology);
+		}
+	}
+
+	auto stitched = std::vector<Primitive>{};
+	for (const auto topology : topologies) {
+		const auto joinable = isList(topology) || primitiveRestart || topology == GL_TRIANGLE_STRIP;
+		if (!joinable) {
+			for (const auto& primitive : primitives) {
+				if (primitive.topology == topology) {
+					stitched.push_back(primitive);
+				}
+			}
+			continue;
+		}
+
+		std::size_t size = 0;
+		for (const auto& [primitiveTopology, indices] : primitives) {
+			if (primitiveTopology == topology) {
+				size += indices.size() + 3;
+			}
+		}
+
+		auto joint = std::vector<IndexType>{};
+		joint.reserve(size);
+		for (const auto& [primitiveTopology, indices] : primitives) {
+			if (primitiveTopology != topology || indices.empty()) {
+				continue;
+			}
+			if (joint.empty() || isList(topology)) {
+				joint.insert(joint.end(), indices.begin(), indices.end());
+			} else if (primitiveRestart) {
+				joint.push_back(RESTART_INDEX);
+				joint.insert(joint.end(), indices.begin(), indices.end());
+			} else {
+				appendDegenerateStrip(joint, indices);
+			}
+		}
+		stitched.emplace_back(topology, std::move(joint));
+	}
+
+	const auto removed = primitives.size() - stitched.size();
+	return { std::move(stitched), removed };
+}
+
+MeshOptimizer::OptimizeResult MeshOptimizer::optimize(
+	const std::vector<Primitive>& primitives,
+	const std::vector<float>& vertices,
+	const std::size_t stride,
+	const bool overdraw
+) {
+	const auto vertexCount = vertices.size() / stride;
+
+	// Everything that rasterizes triangles, as a list in the original draw order
+	auto original = std::vector<IndexType>{};
+	auto originalLists = std::vector<IndexType>{};
+	auto hasStripsOrFans = false;
+	for (const auto& primitive : primitives) {
+		if (!isTriangles(primitive.topology)) {
+			continue;
+		}
+		const auto triangles = toTriangleList(primitive);
+		original.insert(original.end(), triangles.begin(), triangles.end());
+		if (primitive.topology == GL_TRIANGLES) {
+			originalLists.insert(originalLists.end(), triangles.begin(), triangles.end());
+		} else {
+			hasStripsOrFans = true;
+		}
+	}
+	const auto before = analyzeVertexCache(original, vertexCount);
+
+	const auto reorder = [&](const std::vector<IndexType>& triangles) {
+		auto optimized = optimizeVertexCache(triangles, vertexCount);
+		return overdraw ? optimizeOverdraw(optimized, vertices, stride) : optimized;
+	};
+
+	auto optimized = reorder(original);
+	const auto convert = hasStripsOrFans && analyzeVertexCache(optimized, vertexCount).acmr < before.acmr * CONVERSION_THRESHOLD;
+	if (hasStripsOrFans && !convert) {
+		// Strips and fans stay as they are, only the lists get reordered
+		optimized = reorder(originalLists);
+	}
+
+	auto result = std::vector<Primitive>{};
+	for (const auto& primitive : primitives) {
+		const auto replaced = primitive.topology == GL_TRIANGLES || (convert && isTriangles(primitive.topology));
+		if (!replaced) {
+			result.push_back(primitive);
+		}
+	}
+	if (!optimized.empty()) {
+		result.emplace_back(GL_TRIANGLES, std::move(optimized));
+	}
+
+	auto reordered = vertices;
+	optimizeVertexFetch(result, reordered, stride);
+
+	auto final = std::vector<IndexType>{};
+	for (const auto& primitive : result) {
+		if (isTriangles(primitive.topology)) {
+			const auto triangles = toTriangleList(primitive);
+			final.insert(final.end(), triangles.begin(), triangles.end());
+		}
+	}
+	const auto after = analyzeVertexCache(final, reordered.size() / stride);
+
+	return { std::move(result), std::move(reordered), before, after, convert };
+}
+
+std::optional<std::vector<MeshOptimizer::IndexRange>> MeshOptimizer::splitShortRanges(const std::vector<Primitive>& primitives) {
+	auto ranges = std::vector<IndexRange>{};
+
+	for (const auto& [topology, indices] : primitives) {
+		// the units that cannot be cut: single list primitives or whole strips and fans
+		const auto unitSize = topology == GL_TRIANGLES ? 3 : topology == GL_LINES ? 2 : topology == GL_POINTS ? 1 : 0;
+
+		auto chunk = std::vector<IndexType>{};
+		auto low = std::numeric_limits<IndexType>::max();
+		auto high = IndexType{ 0 };
+
+		const auto flush = [&] {
+			if (chunk.empty()) {
+				return;
+			}
+			for (auto& index : chunk) {
+				if (index != RESTART_INDEX) {
+					index -= low;
+				}
+			}
+			ranges.emplace_back(topology, std::move(chunk), low);
+			chunk = {};
+			low = std::numeric_limits<IndexType>::max();
+			high = 0;
+		};
+
+		std::size_t start = 0;
+		while (start < indices.size()) {
+			auto end = start;
+			if (unitSize > 0) {
+				end = std::min(start + unitSize, indices.size());
+			} else {
+				while (end < indices.size() && indices[end] != RESTART_INDEX) {
+					++end;
+				}
+			}
+
+			auto unitLow = std::numeric_limits<IndexType>::max();
+			auto unitHigh = IndexType{ 0 };
+			for (auto i = start; i < end; ++i) {
+				unitLow = std::min(unitLow, indices[i]);
+				unitHigh = std::max(unitHigh, indices[i]);
+			}
+			if (start < end && unitHigh - unitLow >= SHORT_RESTART_INDEX) {
+				return std::nullopt;
+			}
+
+			if (start < end) {
+				if (!chunk.empty() && std::max(high, unitHigh) - std::min(low, unitLow) >= SHORT_RESTART_INDEX) {
+					flush();
+				}
+				if (!chunk.empty() && unitSize == 0) {
+					chunk.push_back(RESTART_INDEX);
+				}
+				chunk.insert(chunk.end(), indices.begin() + static_cast<std::ptrdiff_t>(start), indices.begin() + static_cast<std::ptrdiff_t>(end));
+				low = std::min(low, unitLow);
+				high = std::max(high, unitHigh);
+			}
+
+			// strips and fans skip over the restart index ending them
+			start = unitSize > 0 ? end : end + 1;
+		}
+		flush();
+	}
+
+	return ranges;
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const std::vector<IndexType>& triangles, const std::size_t vertexCount) {
+	if (triangles.empty()) {
+		return { 0.0f, 0.0f };
+	}
+
+	// A FIFO cache simulated with timestamps: a vertex is in the cache while fewer than
+	// CACHE_SIZE other vertices were transformed after it.
+	auto timestamps = std::vector<unsigned int>(vertexCount, 0);
+	auto time = static_cast<unsigned int>(CACHE_SIZE) + 1;
+	std::size_t transformed = 0;
+	std::size_t unique = 0;
+	for (const auto index : triangles) {
+		if (timestamps[index] == 0) {
+			++unique;
+		}
+		if (time - timestamps[index] > CACHE_SIZE) {
+			timestamps[index] = time++;
+			++transformed;
+		}
+	}
+
+	return {
+		static_cast<float>(transformed) / static_cast<float>(triangles.size() / 3),
+		static_cast<float>(transformed) / static_cast<float>(unique)
+	};
+}
+
+std::vector<IndexType> MeshOptimizer::toTriangleList(const Primitive& primitive) {
+	const auto& [topology, indices] = primitive;
+	auto triangles = std::vector<IndexType>{};
+
+	const auto emit = [&triangles](const IndexType a, const IndexType b, const IndexType c) {
+		// zero-area triangles never produce fragments, they only cost vertex work
+		if (a != b && b != c && c != a) {
+			triangles.push_back(a);
+			triangles.push_back(b);
+			triangles.push_back(c);
+		}
+	};
+
+	if (topology == GL_TRIANGLES) {
+		triangles.reserve(indices.size());
+		for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+			emit(indices[i], indices[i + 1], indices[i + 2]);
+		}
+		return triangles;
+	}
+
+	triangles.reserve(indices.size() * 3);
+	std::size_t start = 0;
+	while (start < indices.size()) {
+		// each run between two restart indices is an independent strip or fan
+		auto end = start;
+		while (end < indices.size() && indices[end] != RESTART_INDEX) {
+			++end;
+		}
+		for (auto i = start; i + 2 < end; ++i) {
+			if (topology == GL_TRIANGLE_FAN) {
+				emit(indices[start], indices[i + 1], indices[i + 2]);
+			} else if ((i - start) % 2 == 0) {
+				emit(indices[i], indices[i + 1], indices[i + 2]);
+			} else {
+				// odd strip triangles are flipped to keep a consistent winding
+				emit(indices[i + 1], indices[i], indices[i + 2]);
+			}
+		}
+		start = end + 1;
+	}
+	return triangles;
+}
+
+std::vector<IndexType> MeshOptimizer::optimizeVertexCache(const std::vector<IndexType>& triangles, const std::size_t vertexCount) {
+	const auto triangleCount = triangles.size() / 3;
+	if (triangleCount == 0) {
+		return {};
+	}
+
+	// Triangle adjacency of every vertex, packed in a single array
+	auto remaining = std::vector<unsigned int>(vertexCount, 0);
+	for (const auto index : triangles) {
+		++remaining[index];
+	}
+	auto offsets = std::vector<std::size_t>(vertexCount + 1, 0);
+	for (std::size_t v = 0; v < vertexCount; ++v) {
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+	auto adjacency = std::vector<std::size_t>(triangles.size());
+	auto fill = std::vector(offsets.begin(), offsets.end() - 1);
+	for (std::size_t t = 0; t < triangleCount; ++t) {
+		for (auto k = 0; k < 3; ++k) {
+			adjacency[fill[triangles[t * 3 + k]]++] = t;
+		}
+	}
+
+	auto cachePositions = std::vector<int>(vertexCount, -1);
+	auto vertexScores = std::vector<float>(vertexCount);
+	for (std::size_t v = 0; v < vertexCount; ++v) {
+		vertexScores[v] = vertexScore(-1, remaining[v]);
+	}
+	auto triangleScores = std::vector<float>(triangleCount);
+	for (std::size_t t = 0; t < triangleCount; ++t) {
+		triangleScores[t] = vertexScores[triangles[t * 3]] + vertexScores[triangles[t * 3 + 1]] + vertexScores[triangles[t * 3 + 2]];
+	}
+	auto emitted = std::vector<bool>(triangleCount, false);
+
+	auto cache = std::vector<IndexType>{};
+	auto nextCache = std::vector<IndexType>{};
+	cache.reserve(CACHE_SIZE + 3);
+	nextCache.reserve(CACHE_SIZE + 3);
+
+	auto result = std::vector<IndexType>{};
+	result.reserve(triangles.size());
+
+	constexpr auto NONE = std::numeric_limits<std::size_t>::max();
+	auto best = static_cast<std::size_t>(std::ranges::max_element(triangleScores) - triangleScores.begin());
+	std::size_t cursor = 0;
+
+	while (result.size() < triangleCount * 3) {
+		if (best == NONE) {
+			// nothing left around the cache, resume with the next triangle in input order
+			while (emitted[cursor]) {
+				++cursor;
+			}
+			best = cursor;
+		}
+
+		emitted[best] = true;
+		nextCache.clear();
+		for (auto k = 0; k < 3; ++k) {
+			const auto v = triangles[best * 3 + k];
+			result.push_back(v);
+
+			// drop the triangle from the adjacency of its vertex
+			--remaining[v];
+			const auto first = adjacency.begin() + static_cast<std::ptrdiff_t>(offsets[v]);
+			const auto last = first + remaining[v];
+			std::iter_swap(std::find(first, last + 1, best), last);
+
+			if (std::ranges::find(nextCache, v) == nextCache.end()) {
+				nextCache.push_back(v);
+			}
+		}
+
+		// the emitted vertices move to the front of the LRU cache
+		for (const auto v : cache) {
+			if (std::ranges::find(nextCache, v) == nextCache.end()) {
+				nextCache.push_back(v);
+			}
+		}
+
+		for (std::size_t i = 0; i < nextCache.size(); ++i) {
+			const auto v = nextCache[i];
+			cachePositions[v] = i < CACHE_SIZE ? static_cast<int>(i) : -1;
+			vertexScores[v] = vertexScore(cachePositions[v], remaining[v]);
+		}
+
+		// rescore the triangles around the touched vertices and pick the best one still in the cache
+		best = NONE;
+		auto bestScore = -1.0f;
+		for (const auto v : nextCache) {
+			for (auto a = offsets[v]; a < offsets[v] + remaining[v]; ++a) {
+				const auto t = adjacency[a];
+				triangleScores[t] = vertexScores[triangles[t * 3]] + vertexScores[triangles[t * 3 + 1]] + vertexScores[triangles[t * 3 + 2]];
+				if (cachePositions[v] >= 0 && triangleScores[t] > bestScore) {
+					bestScore = triangleScores[t];
+					best = t;
+				}
+			}
+		}
+
+		if (nextCache.size() > CACHE_SIZE) {
+			nextCache.resize(CACHE_SIZE);
+		}
+		std::swap(cache, nextCache);
+	}
+
+	return result;
+}
+
+std::vector<IndexType> MeshOptimizer::optimizeOverdraw(
+	const std::vector<IndexType>& triangles,
+	const std::vector<float>& vertices,
+	const std::size_t stride
+) {
+	const auto triangleCount = triangles.size() / 3;
+	if (triangleCount == 0) {
+		return {};
+	}
+
+	const auto position = [&](const IndexType index) {
+		const auto base = static_cast<std::size_t>(index) * stride;
+		return glm::vec3{ vertices[base], vertices[base + 1], vertices[base + 2] };
+	};
+
+	// Clusters start where a triangle misses the cache with all its vertices,
+	// so reordering them keeps the cache efficiency of the input
+	auto clusters = std::vector<std::size_t>{ 0 };
+	auto timestamps = std::vector<unsigned int>(vertices.size() / stride, 0);
+	auto time = static_cast<unsigned int>(CACHE_SIZE) + 1;
+	for (std::size_t t = 0; t < triangleCount; ++t) {
+		auto misses = 0;
+		for (auto k = 0; k < 3; ++k) {
+			const auto index = triangles[t * 3 + k];
+			if (time - timestamps[index] > CACHE_SIZE) {
+				timestamps[index] = time++;
+				++misses;
+			}
+		}
+		if (misses == 3 && t > 0) {
+			clusters.push_back(t);
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	auto meshCentroid = glm::vec3{ 0.0f };
+	for (const auto index : triangles) {
+		meshCentroid += position(index);
+	}
+	meshCentroid /= static_cast<float>(triangles.size());
+
+	// Clusters facing away from the center are the most likely to occlude the others
+	auto keys = std::vector<float>(clusters.size() - 1);
+	for (std::size_t c = 0; c + 1 < clusters.size(); ++c) {
+		auto centroid = glm::vec3{ 0.0f };
+		auto normal = glm::vec3{ 0.0f };
+		auto area = 0.0f;
+		for (auto t = clusters[c]; t < clusters[c + 1]; ++t) {
+			const auto p0 = position(triangles[t * 3]);
+			const auto p1 = position(triangles[t * 3 + 1]);
+			const auto p2 = position(triangles[t * 3 + 2]);
+			const auto n = cross(p1 - p0, p2 - p0);
+			const auto a = length(n);
+			centroid += (p0 + p1 + p2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+		const auto normalLength = length(normal);
+		keys[c] = area > 0.0f && normalLength > 0.0f
+			? dot(centroid / area - meshCentroid, normal / normalLength)
+			: 0.0f;
+	}
+
+	auto order = std::vector<std::size_t>(keys.size());
+	for (std::size_t c = 0; c < order.size(); ++c) {
+		order[c] = c;
+	}
+	std::ranges::stable_sort(order, [&keys](const auto a, const auto b) { return keys[a] > keys[b]; });
+
+	auto result = std::vector<IndexType>{};
+	result.reserve(triangles.size());
+	for (const auto c : order) {
+		result.insert(
+			result.end(),
+			triangles.begin() + static_cast<std::ptrdiff_t>(clusters[c] * 3),
+			triangles.begin() + static_cast<std::ptrdiff_t>(clusters[c + 1] * 3)
+		);
+	}
+	return result;
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Primitive>& primitives, std::vector<float>& vertices, const std::size_t stride) {
+	const auto vertexCount = vertices.size() / stride;
+
+	// New vertex ids in order of first use, unreferenced vertices are dropped
+	auto remap = std::vector<IndexType>(vertexCount, RESTART_INDEX);
+	IndexType next = 0;
+	auto rewritten = std::vector<Primitive>{};
+	rewritten.reserve(primitives.size());
+	for (const auto& [topology, indices] : primitives) {
+		auto remapped = indices;
+		for (auto& index : remapped) {
+			if (index == RESTART_INDEX) {
+				continue;
+			}
+			if (remap[index] == RESTART_INDEX) {
+				remap[index] = next++;
+			}
+			index = remap[index];
+		}
+		rewritten.emplace_back(topology, std::move(remapped));
+	}
+
+	auto reordered = std::vector<float>(static_cast<std::size_t>(next) * stride);
+	for (std::size_t v = 0; v < vertexCount; ++v) {
+		if (remap[v] != RESTART_INDEX) {
+			std::copy_n(
+				vertices.begin() + static_cast<std::ptrdiff_t>(v * stride), stride,
+				reordered.begin() + static_cast<std::ptrdiff_t>(remap[v] * stride)
+			);
+		}
+	}
+
+	primitives = std::move(rewritten);
+	vertices = std::move(reordered);
+}
+
+float MeshOptimizer::vertexScore(const int cachePosition, const unsigned int remainingTriangles) {
+	if (remainingTriangles == 0) {
+		return -1.0f;
+	}
+
+	auto score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			// the vertices of the last triangle get a fixed score, whichever order they were used
+			score = LAST_TRIANGLE_SCORE;
+		} else {
+			const auto scaler = 1.0f / (CACHE_SIZE - 3);
+			score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+		}
+	}
+
+	// vertices with few triangles left get a boost, so they are finished off rather than left behind
+	score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+	return score;
+}
+
+bool MeshOptimizer::isTriangles(const int topology) {
+	return topology == GL_TRIANGLES || topology == GL_TRIANGLE_STRIP || topology == GL_TRIANGLE_FAN;
+}
+
+bool MeshOptimizer::isList(const int topology) {
+	return topology == GL_TRIANGLES || topology == GL_LINES || topology == GL_POINTS;
+}
+
+void MeshOptimizer::appendDegenerateStrip(std::vector<IndexType>& strip, const std::vector<IndexType>& next) {
+	// Repeating the last and the first index produces zero-area triangles the GPU discards.
+	// The next strip must also start on an even position, or all its triangles flip winding.
+	const auto last = strip.back();
+	strip.push_back(last);
+	if (strip.size() % 2 == 0) {
+		strip.push_back(last);
+	}
+	strip.push_back(next.front());
+	strip.insert(strip.end(), next.begin(), next.end());
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "drawable/Drawable.h"
+
+class MeshOptimizer {
+public:
+	struct StitchResult {
+		std::vector<Primitive> primitives;
+		std::size_t removedElements;
+	};
+
+	// Merges every primitive sharing a topology into a single one. Strips, fans and line strips
+	// are separated by RESTART_INDEX when primitiveRestart is set; otherwise triangle strips are
+	// joined with degenerate triangles and the topologies that cannot be joined are left alone.
+	[[nodiscard]] static StitchResult stitch(const std::vector<Primitive>& primitives, bool primitiveRestart);
+
+	// Post-transform cache efficiency of a triangle list: ACMR is the number of vertices transformed
+	// per triangle, ATVR the number of vertices transformed per unique vertex (1.0 is ideal for both).
+	struct CacheStats {
+		float acmr;
+		float atvr;
+	};
+
+	struct OptimizeResult {
+		std::vector<Primitive> primitives;
+		std::vector<float> vertices;
+		CacheStats before;
+		CacheStats after;
+		bool convertedToList;
+	};
+
+	// Reorders triangles for the post-transform vertex cache, optionally sorts clusters of triangles
+	// to reduce overdraw, then reorders vertices for fetch locality. Strips and fans get converted
+	// to a triangle list only when the reordered list transforms noticeably fewer vertices.
+	[[nodiscard]] static OptimizeResult optimize(
+		const std::vector<Primitive>& primitives,
+		const std::vector<float>& vertices,
+		std::size_t stride,
+		bool overdraw
+	);
+
+	[[nodiscard]] static CacheStats analyzeVertexCache(const std::vector<IndexType>& triangles, std::size_t vertexCount);
+
+	[[nodiscard]] static std::vector<IndexType> toTriangleList(const Primitive& primitive);
+
+	// Forsyth's linear-speed vertex cache optimization.
+	[[nodiscard]] static std::vector<IndexType> optimizeVertexCache(const std::vector<IndexType>& triangles, std::size_t vertexCount);
+
+	// Splits the triangles into clusters at cache boundaries and draws the outward-facing ones first.
+	[[nodiscard]] static std::vector<IndexType> optimizeOverdraw(
+		const std::vector<IndexType>& triangles,
+		const std::vector<float>& vertices,
+		std::size_t stride
+	);
+
+	// A primitive whose indices are relative to a base vertex.
+	struct IndexRange {
+		int topology;
+		std::vector<IndexType> indices;
+		IndexType baseVertex;
+	};
+
+	// Splits the primitives into ranges that each address fewer than 65,535 vertices from their
+	// base vertex, so they can be drawn with 16-bit indices. Triangles, lines and points are split
+	// individually while strips and fans are only split at restart indices; nothing is returned if
+	// a single strip or fan spans too many vertices.
+	[[nodiscard]] static std::optional<std::vector<IndexRange>> splitShortRanges(const std::vector<Primitive>& primitives);
+
+	// The index GL_PRIMITIVE_RESTART_FIXED_INDEX reserves for the widest index type.
+	static constexpr auto RESTART_INDEX = std::numeric_limits<IndexType>::max();
+
+	// The restart index of 16-bit index buffers, which in turn cannot address that vertex.
+	static constexpr IndexType SHORT_RESTART_INDEX = std::numeric_limits<unsigned short>::max();
+
+	// Size of the FIFO cache used for analysis and optimization.
+	static constexpr auto CACHE_SIZE = 32;
+
+private:
+	[[nodiscard]] static bool isList(int topology);
+
+	[[nodiscard]] static bool isTriangles(int topology);
+
+	static void appendDegenerateStrip(std::vector<IndexType>& strip, const std::vector<IndexType>& next);
+
+	[[nodiscard]] static float vertexScore(int cachePosition, unsigned int remainingTriangles);
+
+	// Reorders the vertices by first use and rewrites the indices of every primitive accordingly.
+	static void optimizeVertexFetch(std::vector<Primitive>& primitives, std::vector<float>& vertices, std::size_t stride);
+
+	// A strip or fan only becomes a list when its ACMR drops below this fraction of the original.
+	static constexpr auto CONVERSION_THRESHOLD = 0.9f;
+
+	static constexpr auto CACHE_DECAY_POWER = 1.5f;
+	static constexpr auto LAST_TRIANGLE_SCORE = 0.75f;
+	static constexpr auto VALENCE_BOOST_SCALE = 2.0f;
+	static constexpr auto VALENCE_BOOST_POWER = 0.5f;
+};
@@ -1,13 +1,190 @@
+#include <format>
+#include <stdexcept>
+
 #include "RenderableManager.h"
+#include "Engine.h"
+
+RenderableManager::Builder::Builder(const Renderable mesh) : _mesh{ mesh } {}
+
+RenderableManager::Builder& RenderableManager::Builder::program(const GLuint program) {
+	_program = program;
+	return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::material(const GLuint texture) {
+	_material = texture;
+	return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::bounds(const MeshBounds& bounds) {
+	_bounds = bounds;
+	return *this;
+}
 
-RenderableManager::Builder::Builder(const int count) {
-	
+RenderableManager::Builder& RenderableManager::Builder::layerMask(const std::uint8_t mask) {
+	_layerMask = mask;
+	return *this;
 }
 
-RenderableManager::Builder& RenderableManager::Builder::shader(
-	const int index, 
-	const GLuint program
-) {
+RenderableManager::Builder& RenderableManager::Builder::visible(const bool visible) {
+	_visible = visible;
 	return *this;
 }
 
+void RenderableManager::Builder::build(Engine& engine, const Entity entity) const {
+	engine.getRenderableManager()->create(entity, *this);
+}
+
+void RenderableManager::create(const Entity entity, const Builder& builder) {
+	const auto found = _engine.findMesh(builder._mesh);
+	if (!found) {
+		throw std::invalid_argument(std::format("Renderable {} has no mesh loaded.\n", builder._mesh));
+	}
+	const auto& mesh = *found;
+
+	auto flags = std::uint8_t{ 0 };
+	if (_engine._lodChains.contains(builder._mesh)) {
+		flags |= LEVELS;
+	}
+	if (_engine._instancedMeshes.contains(builder._mesh)) {
+		flags |= INSTANCED;
+	}
+	if (builder._bounds) {
+		flags |= OWN_BOUNDS;
+	}
+
+	auto instance = findInstance(entity);
+	if (instance == NONE) {
+		const auto slot = EntityManager::getIndex(entity);
+		if (slot >= _sparse.size()) {
+			_sparse.resize(slot + 1, NONE);
+		} else if (_sparse[slot] != NONE) {
+			// an older entity of the slot kept its component, which would be lost to the sparse index
+			destroy(_entities[_sparse[slot]]);
+		}
+		instance = static_cast<Instance>(_entities.size());
+		_sparse[slot] = instance;
+		_entities.push_back(entity);
+		_meshes.emplace_back();
+		_programs.emplace_back();
+		_materials.emplace_back();
+		_bounds.emplace_back();
+		_layerMasks.emplace_back();
+		_visible.emplace_back();
+		_flags.emplace_back();
+	}
+	_meshes[instance] = builder._mesh;
+	_programs[instance] = builder._program.value_or(mesh.shader);
+	_materials[instance] = builder._material;
+	_bounds[instance] = builder._bounds.value_or(_engine.getMeshBounds(builder._mesh));
+	_layerMasks[instance] = builder._layerMask;
+	_visible[instance] = builder._visible;
+	_flags[instance] = flags;
+
+	updateScenes(entity);
+}
+
+void RenderableManager::updateMeshBounds(const Renderable mesh, const MeshBounds& bounds) {
+	for (Instance instance = 0; instance < _entities.size(); ++instance) {
+		if (_meshes[instance] != mesh || _flags[instance] & OWN_BOUNDS) {
+			continue;
+		}
+		_bounds[instance] = bounds;
+		updateScenes(_entities[instance]);
+	}
+}
+
+void RenderableManager::updateScenes(const Entity entity) const {
+	for (const auto scene : _engine._scenes) {
+		if (const auto it = scene->_indices.find(entity); it != scene->_indices.end()) {
+			scene->updateBounds(it->second);
+		}
+	}
+}
+
+void RenderableManager::destroy(const Entity entity) {
+	const auto instance = findInstance(entity);
+	if (instance == NONE) {
+		return;
+	}
+
+	// Swap with the last component to keep the arrays packed
+	const auto last = static_cast<Instance>(_entities.size() - 1);
+	if (instance != last) {
+		_entities[instance] = _entities[last];
+		_meshes[instance] = _meshes[last];
+		_programs[instance] = _programs[last];
+		_materials[instance] = _materials[last];
+		_bounds[instance] = _bounds[last];
+		_layerMasks[instance] = _layerMasks[last];
+		_visible[instance] = _visible[last];
+		_flags[instance] = _flags[last];
+		_sparse[EntityManager::getIndex(_entities[instance])] = instance;
+	}
+	_sparse[EntityManager::getIndex(entity)] = NONE;
+	_entities.pop_back();
+	_meshes.pop_back();
+	_programs.pop_back();
+	_materials.pop_back();
+	_bounds.pop_back();
+	_layerMasks.pop_back();
+	_visible.pop_back();
+	_flags.pop_back();
+
+	// the scenes see the component gone, and take the entity out of their hierarchies
+	updateScenes(entity);
+}
+
+bool RenderableManager::hasComponent(const Entity entity) const {
+	return findInstance(entity) != NONE;
+}
+
+std::size_t RenderableManager::getComponentCount() const {
+	return _entities.size();
+}
+
+Renderable RenderableManager::getMesh(const Entity entity) const {
+	return _meshes[getInstance(entity)];
+}
+
+const MeshBounds& RenderableManager::getBounds(const Entity entity) const {
+	return _bounds[getInstance(entity)];
+}
+
+void RenderableManager::setMaterial(const Entity entity, const GLuint texture) {
+	_materials[getInstance(entity)] = texture;
+}
+
+void RenderableManager::setLayerMask(const Entity entity, const std::uint8_t mask) {
+	_layerMasks[getInstance(entity)] = mask;
+}
+
+std::uint8_t RenderableManager::getLayerMask(const Entity entity) const {
+	return _layerMasks[getInstance(entity)];
+}
+
+void RenderableManager::setVisible(const Entity entity, const bool visible) {
+	_visible[getInstance(entity)] = visible;
+}
+
+bool RenderableManager::isVisible(const Entity entity) const {
+	return _visible[getInstance(entity)] != 0;
+}
+
+RenderableManager::Instance RenderableManager::findInstance(const Entity entity) const {
+	// the slot may have been handed to a newer entity since
+	const auto slot = EntityManager::getIndex(entity);
+	if (slot >= _sparse.size()) {
+		return NONE;
+	}
+	const auto instance = _sparse[slot];
+	return instance != NONE && _entities[instance] == entity ? instance : NONE;
+}
+
+RenderableManager::Instance RenderableManager::getInstance(const Entity entity) const {
+	const auto instance = findInstance(entity);
+	if (instance == NONE) {
+		throw std::invalid_argument(std::format("Entity {} has no renderable.\n", entity));
+	}
+	return instance;
+}
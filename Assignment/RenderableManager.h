@@ -2,21 +2,130 @@
 
 #include <glad/glad.h>
 
-class RenderableManager {
-	enum class PrimitiveType {
-		TRIANGLES = GL_TRIANGLES,
-		TRIANGLE_STRIP = GL_TRIANGLE_STRIP
-	};
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "EntityManager.h"
+#include "Mesh.h"
 
+class Engine;
+
+// What an entity draws and how, packed into parallel arrays indexed by component, so the renderer goes
+// through contiguous memory for everything it needs of an entity. Entities find their component through
+// a sparse array indexed by their slot, and destroying a component moves the last one into its place.
+class RenderableManager {
+public:
 	class Builder {
 	public:
-		explicit Builder(int count);
+		explicit Builder(Renderable mesh);
+
+		// Draws the mesh with another program, which must read the vertex layout of the mesh.
+		Builder& program(GLuint program);
+
+		// A texture bound in place of those of the elements of the mesh.
+		Builder& material(GLuint texture);
+
+		// Bounds in the space of the mesh, in place of those computed when it was loaded.
+		Builder& bounds(const MeshBounds& bounds);
+
+		// The layers the entity belongs to, it is drawn by the views showing any of them.
+		Builder& layerMask(std::uint8_t mask);
+
+		Builder& visible(bool visible);
+
+		// Gives the entity the component, replacing the one it had, and moves its bounds in the scenes holding it.
+		// A component still held by a destroyed entity of the same slot is destroyed first.
+		void build(Engine& engine, Entity entity) const;
 
-		Builder& shader(int index, GLuint program);
+		friend class RenderableManager;
 
 	private:
-		GLuint* _programs{ nullptr };
+		Renderable _mesh;
+		std::optional<GLuint> _program{};
+		GLuint _material{ 0 };
+		std::optional<MeshBounds> _bounds{};
+		std::uint8_t _layerMask{ DEFAULT_LAYER };
+		bool _visible{ true };
+	};
+
+	// Scenes holding the entity drop its bounds and skip it until it gets a component again.
+	void destroy(Entity entity);
+
+	[[nodiscard]] bool hasComponent(Entity entity) const;
+
+	[[nodiscard]] std::size_t getComponentCount() const;
+
+	[[nodiscard]] Renderable getMesh(Entity entity) const;
+
+	[[nodiscard]] const MeshBounds& getBounds(Entity entity) const;
+
+	void setMaterial(Entity entity, GLuint texture);
+
+	void setLayerMask(Entity entity, std::uint8_t mask);
+
+	[[nodiscard]] std::uint8_t getLayerMask(Entity entity) const;
+
+	void setVisible(Entity entity, bool visible);
+
+	[[nodiscard]] bool isVisible(Entity entity) const;
 
-		
+	static constexpr std::uint8_t DEFAULT_LAYER = 1;
+
+	friend class Engine;
+
+	friend class Renderer;
+
+	friend class Scene;
+
+private:
+	explicit RenderableManager(Engine& engine) : _engine{ engine } {}
+
+	using Instance = std::uint32_t;
+
+	static constexpr auto NONE = std::numeric_limits<Instance>::max();
+
+	// What the renderer would otherwise look up in the engine for every entity.
+	enum Flags : std::uint8_t {
+		LEVELS = 1 << 0,	// the mesh has coarser levels of detail
+		INSTANCED = 1 << 1,	// the mesh is an instanced mesh
+		OWN_BOUNDS = 1 << 2	// the bounds came from the builder rather than the mesh
 	};
+
+	void create(Entity entity, const Builder& builder);
+
+	// NONE for entities without a component.
+	[[nodiscard]] Instance findInstance(Entity entity) const;
+
+	[[nodiscard]] Instance getInstance(Entity entity) const;
+
+	// Gives the components drawing the mesh its new bounds, unless they have their own, and moves them
+	// in the scenes holding their entities. Goes through every component, which is a pass over one array.
+	void updateMeshBounds(Renderable mesh, const MeshBounds& bounds);
+
+	// Brings the bounds of the entity up to date with its component in every scene holding it.
+	void updateScenes(Entity entity) const;
+
+	Engine& _engine;
+
+	// The component of each entity slot, NONE for slots without one.
+	std::vector<Instance> _sparse{};
+
+	std::vector<Entity> _entities{};
+
+	std::vector<Renderable> _meshes{};
+
+	std::vector<GLuint> _programs{};
+
+	std::vector<GLuint> _materials{};	// 0 to keep the textures of the mesh
+
+	std::vector<MeshBounds> _bounds{};
+
+	std::vector<std::uint8_t> _layerMasks{};
+
+	std::vector<std::uint8_t> _visible{};
+
+	std::vector<std::uint8_t> _flags{};
 };
\ No newline at end of file
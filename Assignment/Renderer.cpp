@@ -1,8 +1,26 @@
 #include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
 
 #include "Renderer.h"
+#include "Engine.h"
+#include "Frustum.h"
+#include "Shader.h"
+
+Renderer::Renderer(const Engine& engine) : _engine{ engine } {
+	glGenBuffers(1, &_frameUniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, _frameUniformBuffer);
+	glBufferStorage(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
 
-void Renderer::render(View* const view) const {
+Renderer::~Renderer() {
+	glDeleteBuffers(1, &_frameUniformBuffer);
+}
+
+void Renderer::render(View* const view) {
 	auto clearMask = GL_DEPTH_BUFFER_BIT;
 	if (_clearOptions.clear) {
 		glClearColor(
@@ -14,6 +32,221 @@ void Renderer::render(View* const view) const {
 		clearMask |= GL_COLOR_BUFFER_BIT;
 	}
 	glClear(clearMask);
+
+	const auto scene = view->getScene();
+	const auto camera = view->getCamera();
+	if (!scene || !camera) {
+		return;
+	}
+
+	// The view and projection are shared by every program through the frame block
+	updateFrameUniforms(*camera);
+	glBindBufferBase(GL_UNIFORM_BUFFER, Shader::getBinding(Shader::UniformBlock::FRAME), _frameUniformBuffer);
+
+	// Entities without a transform sit at the origin of the world
+	static const auto IDENTITY = glm::mat4(1.0f);
+	const auto viewMatrix = camera->getViewMatrix();
+
+	const auto projection = camera->getProjection();
+	const auto perspective = projection[2][3] != 0.0f;
+
+	// Small scenes cull fastest in a flat pass over all the spheres at once, large ones by walking the hierarchy
+	// down only the branches the frustum reaches. The spheres being loose, the boxes get a second look.
+	const auto count = scene->_entities.size();
+	const auto frustum = Frustum{ projection * viewMatrix };
+	_visibleEntries.clear();
+	if (count < HIERARCHICAL_CULLING_COUNT) {
+		_visible.resize(count);
+		frustum.intersects(scene->_sphereX, scene->_sphereY, scene->_sphereZ, scene->_sphereRadius, _visible);
+		for (std::size_t k = 0; k < count; ++k) {
+			if (_visible[k] && frustum.intersects(scene->_boxMin[k], scene->_boxMax[k])) {
+				_visibleEntries.push_back(k);
+			}
+		}
+	} else {
+		scene->_bvh.query(frustum, [&](const auto k, const auto contained) {
+			if (contained || frustum.intersects(scene->_boxMin[k], scene->_boxMax[k])) {
+				_visibleEntries.push_back(k);
+			}
+		});
+	}
+	_culledCount = count - _visibleEntries.size();
+
+	// Gather one command per renderable left, everything but the level and the mesh coming out of the
+	// packed arrays of the components, and the maps of the engine only consulted when the flags say so
+	const auto& renderables = _engine._renderableManager;
+	const auto layers = view->getLayerMask();
+	_commands.clear();
+	_commands.reserve(_visibleEntries.size());
+	for (const auto k : _visibleEntries) {
+		const auto instance = renderables.findInstance(scene->_entities[k]);
+		if (instance == RenderableManager::NONE || !renderables._visible[instance] || !(renderables._layerMasks[instance] & layers)) {
+			continue;
+		}
+		auto renderable = renderables._meshes[instance];
+		if (!_engine.findMesh(renderable)) {
+			continue;
+		}
+		const auto flags = renderables._flags[instance];
+		auto instanceCount = std::size_t{ 0 };
+		if (flags & RenderableManager::INSTANCED) {
+			const auto instanced = _engine._instancedMeshes.find(renderable);
+			if (instanced == _engine._instancedMeshes.end() || instanced->second.count == 0) {
+				continue;
+			}
+			instanceCount = instanced->second.count;
+		}
+
+		// Every level shares the finest level's bounds, so the choice does not depend on the level drawn
+		const auto center = glm::vec3{ scene->_sphereX[k], scene->_sphereY[k], scene->_sphereZ[k] };
+		const auto radius = scene->_sphereRadius[k];
+		const auto depth = -(viewMatrix * glm::vec4{ center, 1.0f }).z;
+
+		const auto chain = flags & RenderableManager::LEVELS ? _engine._lodChains.find(renderable) : _engine._lodChains.end();
+		if (chain != _engine._lodChains.end()) {
+			const auto& levels = chain->second;
+			const auto screenSize = perspective
+				? radius * projection[1][1] / std::max(depth, camera->getNear())
+				: radius * projection[1][1];
+			scene->_levels[k] = selectLevel(screenSize, scene->_levels[k], levels.size());
+			renderable = levels[scene->_levels[k]];
+		}
+
+		const auto& mesh = *_engine.findMesh(renderable);
+		const auto program = renderables._programs[instance];
+		const auto material = renderables._materials[instance];
+		const auto texture = material != 0 ? material : mesh.batches.empty() ? 0u : mesh.batches.front().texture;
+		_commands.push_back(DrawCommand{
+			makeSortKey(program, mesh.vao, texture, depth, camera->getFar()), renderable,
+			_engine._transformManager.findWorldTransform(scene->_entities[k]), program, material, instanceCount
+		});
+	}
+
+	std::ranges::sort(_commands, {}, &DrawCommand::key);
+
+	auto currentProgram = 0u;
+	auto currentVao = 0u;
+	auto currentTexture = 0u;
+	auto currentIndirectBuffer = 0u;
+	auto currentModel = static_cast<const glm::mat4*>(nullptr);
+	auto modelLocation = -1;
+
+	glActiveTexture(GL_TEXTURE0);
+	for (const auto& [key, renderable, worldTransform, program, material, instanceCount] : _commands) {
+		const auto& [vao, shader, elements, indirectBuffer, batches, indexType, geometry, commands, bounds] = *_engine.findMesh(renderable);
+
+		if (program != currentProgram) {
+			currentProgram = program;
+			glUseProgram(program);
+			modelLocation = Shader::getReflection(program)[Shader::Uniform::MODEL];
+			currentModel = nullptr;
+		}
+
+		// Uniforms are per program state, so the model matrix goes again after every program switch,
+		// and otherwise only when it changes, which for entities without a transform is never
+		const auto model = worldTransform ? worldTransform : &IDENTITY;
+		if (model != currentModel) {
+			currentModel = model;
+			glUniformMatrix4fv(modelLocation, 1, GL_FALSE, value_ptr(*model));
+		}
+
+		if (vao != currentVao) {
+			currentVao = vao;
+			glBindVertexArray(vao);
+		}
+
+		// Instanced meshes draw every instance of an element in one call, reading the instances through their VAO
+		if (instanceCount > 0) {
+			const auto indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+			for (const auto& element : elements) {
+				if (const auto texture = material != 0 ? material : element.texture; texture != currentTexture) {
+					currentTexture = texture;
+					glBindTexture(GL_TEXTURE_2D, texture);
+				}
+
+				glDrawElementsInstancedBaseVertexBaseInstance(
+					element.topology, static_cast<GLsizei>(element.count), indexType,
+					reinterpret_cast<void*>(element.offset * indexSize), // NOLINT(performance-no-int-to-ptr)
+					static_cast<GLsizei>(instanceCount), element.baseVertex, 0
+				);
+			}
+			continue;
+		}
+
+		if (indirectBuffer != currentIndirectBuffer) {
+			currentIndirectBuffer = indirectBuffer;
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		}
+
+		// A whole mesh costs one call per topology and texture, however many elements it has
+		for (const auto& [topology, batchTexture, drawCount, offset] : batches) {
+			if (const auto texture = material != 0 ? material : batchTexture; texture != currentTexture) {
+				currentTexture = texture;
+				glBindTexture(GL_TEXTURE_2D, texture);
+			}
+
+			glMultiDrawElementsIndirect(
+				topology, indexType,
+				reinterpret_cast<void*>(offset), // NOLINT(performance-no-int-to-ptr)
+				drawCount, 0
+			);
+		}
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void Renderer::updateFrameUniforms(const Camera& camera) {
+	if (&camera == _frameCamera && camera.getVersion() == _frameCameraVersion) {
+		return;
+	}
+
+	const auto view = camera.getViewMatrix();
+	const auto projection = camera.getProjection();
+	const auto uniforms = FrameUniforms{ view, projection, projection * view };
+
+	glBindBuffer(GL_UNIFORM_BUFFER, _frameUniformBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &uniforms);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	_frameCamera = &camera;
+	_frameCameraVersion = camera.getVersion();
+}
+
+std::uint8_t Renderer::selectLevel(const float screenSize, const std::uint8_t current, const std::size_t levelCount) {
+	// The size below which the given level takes over from the one finer than it
+	const auto threshold = [](const std::size_t level) {
+		return LOD_SCREEN_SIZE / static_cast<float>(1u << 2 * (level - 1));
+	};
+
+	auto level = std::min<std::size_t>(current, levelCount - 1);
+	while (level + 1 < levelCount && screenSize < threshold(level + 1) * (1.0f - LOD_HYSTERESIS)) {
+		++level;
+	}
+	while (level > 0 && screenSize > threshold(level) * (1.0f + LOD_HYSTERESIS)) {
+		--level;
+	}
+	return static_cast<std::uint8_t>(level);
+}
+
+std::uint64_t Renderer::makeSortKey(
+	const GLuint program, const GLuint vao, const GLuint texture,
+	const float depth, const float farPlane
+) {
+	// Front to back inside a state bucket, so the early depth test rejects as much as possible
+	const auto normalizedDepth = std::clamp(depth / farPlane, 0.0f, 1.0f);
+	const auto quantizedDepth = static_cast<std::uint64_t>(normalizedDepth * ((1u << DEPTH_BITS) - 1));
+
+	auto key = static_cast<std::uint64_t>(program & ((1u << PROGRAM_BITS) - 1));
+	key = key << VAO_BITS | (vao & ((1u << VAO_BITS) - 1));
+	key = key << TEXTURE_BITS | (texture & ((1u << TEXTURE_BITS) - 1));
+	key = key << DEPTH_BITS | quantizedDepth;
+	return key;
+}
+
+std::size_t Renderer::getCulledCount() const {
+	return _culledCount;
 }
 
 void Renderer::setClearOptions(const ClearOptions& options) {
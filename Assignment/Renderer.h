@@ -1,8 +1,16 @@
 #pragma once
 
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
 #include <array>
+#include <cstdint>
+#include <vector>
 
 #include "View.h"
+#include "Mesh.h"
+
+class Engine;
 
 using ClearColor = std::array<float, 4>;
 
@@ -18,8 +26,82 @@ public:
 
 	[[nodiscard]] ClearOptions getClearOptions() const;
 
-	void render(View* view) const;
+	void render(View* view);
+
+	// How many renderables the last render left out for lying outside the view frustum.
+	[[nodiscard]] std::size_t getCulledCount() const;
+
+	~Renderer();
+	Renderer(const Renderer&) = delete;
+	Renderer(Renderer&&) noexcept = delete;
+	Renderer& operator=(const Renderer&) = delete;
+	Renderer& operator=(Renderer&&) noexcept = delete;
+
+	friend class Engine;
 
 private:
+	explicit Renderer(const Engine& engine);
+
+	// Mirrors the std140 Frame block declared by the shaders.
+	struct FrameUniforms {
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::mat4 viewProjection;
+	};
+
+	struct DrawCommand {
+		std::uint64_t key;
+		Renderable renderable;		// the level drawn
+		const glm::mat4* model;		// the world transform of the entity, nullptr for the identity
+		GLuint program;
+		GLuint material;			// 0 to bind the textures of the mesh
+		std::size_t instanceCount;	// 0 for meshes that are not instanced
+	};
+
+	// Sort key layout, from the most significant bit:
+	// [ program : 12 | vao : 20 | texture : 16 | depth : 16 ]
+	// Sorting the keys groups draws by the most expensive state change first.
+	[[nodiscard]] static std::uint64_t makeSortKey(
+		GLuint program, GLuint vao, GLuint texture,
+		float depth, float farPlane
+	);
+
+	void updateFrameUniforms(const Camera& camera);
+
+	// A level is dropped once the bounding sphere's projected radius, in NDC units, falls below
+	// LOD_SCREEN_SIZE for the first coarser level, and a quarter of that for each one after.
+	static constexpr auto LOD_SCREEN_SIZE = 0.5f;
+
+	// How far past a threshold the size must go before the level changes, so a mesh sitting
+	// right on one does not flip between levels every frame.
+	static constexpr auto LOD_HYSTERESIS = 0.15f;
+
+	[[nodiscard]] static std::uint8_t selectLevel(float screenSize, std::uint8_t current, std::size_t levelCount);
+
+	const Engine& _engine;
+
 	ClearOptions _clearOptions{};
-};
\ No newline at end of file
+
+	GLuint _frameUniformBuffer{ 0 };
+
+	// The camera whose matrices currently sit in the frame uniform buffer, and its version at the time.
+	const Camera* _frameCamera{ nullptr };
+	std::uint64_t _frameCameraVersion{ 0 };
+
+	// Kept across frames so the draw list does not reallocate every frame.
+	std::vector<DrawCommand> _commands{};
+
+	// Which of the scene's renderables the flat culling pass kept, and the indices of all those kept either way.
+	std::vector<std::uint8_t> _visible{};
+	std::vector<std::size_t> _visibleEntries{};
+
+	// From how many renderables on the culling walks the scene's hierarchy rather than testing them all.
+	static constexpr auto HIERARCHICAL_CULLING_COUNT = std::size_t{ 2048 };
+
+	std::size_t _culledCount{ 0 };
+
+	static constexpr auto PROGRAM_BITS = 12;
+	static constexpr auto VAO_BITS = 20;
+	static constexpr auto TEXTURE_BITS = 16;
+	static constexpr auto DEPTH_BITS = 16;
+};
@@ -1,3 +1,187 @@
+#include <algorithm>
+#include <format>
+#include <limits>
+#include <stdexcept>
 
 #include "Scene.h"
+#include "Engine.h"
 
+void Scene::addEntity(const Entity entity) {
+	if (!_engine._renderableManager.hasComponent(entity)) {
+		throw std::invalid_argument(std::format("Entity {} has no renderable.\n", entity));
+	}
+	if (const auto it = _indices.find(entity); it != _indices.end()) {
+		updateBounds(it->second);
+		return;
+	}
+
+	const auto index = _entities.size();
+	_indices[entity] = index;
+	_entities.push_back(entity);
+	_levels.push_back(0);
+	_sphereX.push_back(0.0f);
+	_sphereY.push_back(0.0f);
+	_sphereZ.push_back(0.0f);
+	_sphereRadius.push_back(0.0f);
+	_boxMin.emplace_back(0.0f);
+	_boxMax.emplace_back(0.0f);
+	_proxies.push_back(DynamicBvh::NONE);
+
+	updateBounds(index);
+}
+
+void Scene::addEntity(const Entity entity, const Renderable renderable) {
+	const auto& renderables = _engine._renderableManager;
+	if (!renderables.hasComponent(entity)) {
+		RenderableManager::Builder(renderable).build(_engine, entity);
+	} else if (const auto mesh = renderables.getMesh(entity); mesh != renderable) {
+		throw std::invalid_argument(std::format("Entity {} already draws renderable {}, not {}.\n", entity, mesh, renderable));
+	}
+	addEntity(entity);
+}
+
+void Scene::remove(const Entity entity) {
+	const auto it = _indices.find(entity);
+	if (it == _indices.end()) {
+		return;
+	}
+	const auto index = it->second;
+	_indices.erase(it);
+	if (_proxies[index] != DynamicBvh::NONE) {
+		_bvh.remove(_proxies[index]);
+	}
+
+	// Swap with the last entry to keep the arrays packed, the order does not matter
+	// since the renderer sorts its draws anyway.
+	const auto last = _entities.size() - 1;
+	if (index != last) {
+		_entities[index] = _entities[last];
+		_levels[index] = _levels[last];
+		_sphereX[index] = _sphereX[last];
+		_sphereY[index] = _sphereY[last];
+		_sphereZ[index] = _sphereZ[last];
+		_sphereRadius[index] = _sphereRadius[last];
+		_boxMin[index] = _boxMin[last];
+		_boxMax[index] = _boxMax[last];
+		_proxies[index] = _proxies[last];
+		_indices[_entities[index]] = index;
+		if (_proxies[index] != DynamicBvh::NONE) {
+			_bvh.setValue(_proxies[index], static_cast<std::uint32_t>(index));
+		}
+	}
+	_entities.pop_back();
+	_levels.pop_back();
+	_sphereX.pop_back();
+	_sphereY.pop_back();
+	_sphereZ.pop_back();
+	_sphereRadius.pop_back();
+	_boxMin.pop_back();
+	_boxMax.pop_back();
+	_proxies.pop_back();
+}
+
+void Scene::setBounds(const Entity entity, const glm::vec3& min, const glm::vec3& max) {
+	const auto it = _indices.find(entity);
+	if (it == _indices.end()) {
+		return;
+	}
+	const auto index = it->second;
+
+	// a box tells nothing tighter about the sphere than the one around the box
+	setBounds(index, MeshBounds{ (min + max) * 0.5f, glm::length(max - min) * 0.5f, min, max });
+	if (_proxies[index] == DynamicBvh::NONE) {
+		_proxies[index] = _bvh.insert(min, max, static_cast<std::uint32_t>(index));
+	} else {
+		_bvh.move(_proxies[index], min, max);
+	}
+}
+
+std::size_t Scene::getRenderableCount() const {
+	return _entities.size();
+}
+
+std::vector<Entity> Scene::overlap(const glm::vec3& min, const glm::vec3& max) const {
+	// the leaves carry a margin, so their exact boxes get the final say
+	auto entities = std::vector<Entity>{};
+	_bvh.query(min, max, [&](const auto index) {
+		const auto& boxMin = _boxMin[index];
+		const auto& boxMax = _boxMax[index];
+		if (boxMin.x <= max.x && min.x <= boxMax.x && boxMin.y <= max.y && min.y <= boxMax.y
+			&& boxMin.z <= max.z && min.z <= boxMax.z) {
+			entities.push_back(_entities[index]);
+		}
+	});
+	return entities;
+}
+
+std::vector<std::pair<float, Entity>> Scene::raycast(
+	const glm::vec3& origin, const glm::vec3& direction, const float maxDistance
+) const {
+	auto hits = std::vector<std::pair<float, Entity>>{};
+	const auto inverse = 1.0f / direction;
+	_bvh.raycast(origin, direction, maxDistance, [&](const auto index, float) {
+		// the leaves carry a margin, so the exact box decides where the ray enters
+		if (const auto entry = DynamicBvh::intersectRay(origin, inverse, maxDistance, _boxMin[index], _boxMax[index])) {
+			hits.emplace_back(*entry, _entities[index]);
+		}
+		return maxDistance;
+	});
+	std::ranges::sort(hits);
+	return hits;
+}
+
+void Scene::optimize() {
+	_bvh.rebuild();
+}
+
+void Scene::setBounds(const std::size_t index, const MeshBounds& bounds) {
+	_sphereX[index] = bounds.center.x;
+	_sphereY[index] = bounds.center.y;
+	_sphereZ[index] = bounds.center.z;
+	_sphereRadius[index] = bounds.radius;
+	_boxMin[index] = bounds.min;
+	_boxMax[index] = bounds.max;
+}
+
+void Scene::updateBounds(const std::size_t index) {
+	// An entity whose component went gets a sphere no frustum can see, and leaves the hierarchy
+	const auto& renderables = _engine._renderableManager;
+	const auto instance = renderables.findInstance(_entities[index]);
+	if (instance == RenderableManager::NONE) {
+		_sphereRadius[index] = -std::numeric_limits<float>::infinity();
+		if (_proxies[index] != DynamicBvh::NONE) {
+			_bvh.remove(_proxies[index]);
+			_proxies[index] = DynamicBvh::NONE;
+		}
+		return;
+	}
+
+	// Without a transform, the renderable sits at the origin of the world
+	const auto& bounds = renderables._bounds[instance];
+	const auto world = _engine._transformManager.findWorldTransform(_entities[index]);
+	setBounds(index, world ? transformBounds(bounds, *world) : bounds);
+	if (_proxies[index] == DynamicBvh::NONE) {
+		_proxies[index] = _bvh.insert(_boxMin[index], _boxMax[index], static_cast<std::uint32_t>(index));
+	} else {
+		_bvh.move(_proxies[index], _boxMin[index], _boxMax[index]);
+	}
+}
+
+MeshBounds Scene::transformBounds(const MeshBounds& bounds, const glm::mat4& transform) {
+	// each axis of the box reaches as far as the absolute columns of the transform take its half extents
+	const auto center = glm::vec3{ transform * glm::vec4{ (bounds.min + bounds.max) * 0.5f, 1.0f } };
+	const auto halfExtent = (bounds.max - bounds.min) * 0.5f;
+	const auto extent = glm::abs(glm::vec3{ transform[0] }) * halfExtent.x
+		+ glm::abs(glm::vec3{ transform[1] }) * halfExtent.y
+		+ glm::abs(glm::vec3{ transform[2] }) * halfExtent.z;
+
+	const auto scale = std::max({
+		glm::length(glm::vec3{ transform[0] }),
+		glm::length(glm::vec3{ transform[1] }),
+		glm::length(glm::vec3{ transform[2] })
+	});
+	return {
+		glm::vec3{ transform * glm::vec4{ bounds.center, 1.0f } }, bounds.radius * scale,
+		center - extent, center + extent
+	};
+}
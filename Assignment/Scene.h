@@ -1,9 +1,92 @@
 #pragma once
 
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "DynamicBvh.h"
+#include "EntityManager.h"
+#include "Mesh.h"
+
+class Engine;
+
 class Scene {
 public:
+	// The entity must have a renderable component, which decides what it draws.
+	// Adding an entity the scene already holds only refreshes its bounds.
+	void addEntity(Entity entity);
+
+	// Same as above, first giving the entity a component drawing the mesh if it has none.
+	// Throws if the component it has draws another mesh.
+	void addEntity(Entity entity, Renderable renderable);
+
+	void remove(Entity entity);
+
+	// Moves the bounds of the entity, in world space, for when it moves. The hierarchy is only touched
+	// once they leave the margin it keeps around them. Entities with a transform have their bounds
+	// moved along with it, until then these stand in.
+	void setBounds(Entity entity, const glm::vec3& min, const glm::vec3& max);
+
+	[[nodiscard]] std::size_t getRenderableCount() const;
+
+	// The entities whose bounds overlap the box.
+	[[nodiscard]] std::vector<Entity> overlap(const glm::vec3& min, const glm::vec3& max) const;
+
+	// The entities whose bounds the ray goes through within the distance, along with where it enters them,
+	// nearest first.
+	[[nodiscard]] std::vector<std::pair<float, Entity>> raycast(
+		const glm::vec3& origin, const glm::vec3& direction, float maxDistance
+	) const;
+
+	// Rebuilds the hierarchy in one go, tighter than what adding the entities one at a time leaves,
+	// worth it after adding or moving a lot of them at once.
+	void optimize();
+
+	friend class Engine;
+
+	friend class RenderableManager;
+
+	friend class Renderer;
+
+	friend class TransformManager;
 
 private:
+	explicit Scene(Engine& engine) : _engine{ engine } {}
+
+	void setBounds(std::size_t index, const MeshBounds& bounds);
+
+	// Places the bounds of the renderable at the world transform of the entity, if it has one, and moves its leaf.
+	void updateBounds(std::size_t index);
+
+	// Bounds around the ones given once transformed, the box around the transformed box and the sphere
+	// grown by the largest scale.
+	static [[nodiscard]] MeshBounds transformBounds(const MeshBounds& bounds, const glm::mat4& transform);
+
+	Engine& _engine;
+
+	// Parallel arrays, so culling walks the bounds without touching anything else.
+	std::vector<Entity> _entities{};
+
+	// The level of detail each renderable was drawn at last frame, for the renderer's hysteresis.
+	std::vector<std::uint8_t> _levels{};
+
+	// The bounds of each renderable in world space, the spheres one array per component
+	// so the renderer can cull them several at a time.
+	std::vector<float> _sphereX{};
+	std::vector<float> _sphereY{};
+	std::vector<float> _sphereZ{};
+	std::vector<float> _sphereRadius{};
+	std::vector<glm::vec3> _boxMin{};
+	std::vector<glm::vec3> _boxMax{};
+
+	// The leaf of each renderable in the hierarchy, whose value is its index in the arrays.
+	std::vector<DynamicBvh::Proxy> _proxies{};
+
+	DynamicBvh _bvh{};
+
+	// Where each entity sits in the arrays.
+	std::unordered_map<Entity, std::size_t> _indices{};
 };
@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 
 #include "Shader.h"
 
@@ -37,9 +39,76 @@ GLuint Shader::createProgram(
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
 
+	_reflections[shaderProgram] = reflect(shaderProgram);
+
 	return shaderProgram;
 }
 
+const Shader::Reflection& Shader::getReflection(const GLuint program) {
+	const auto it = _reflections.find(program);
+	if (it == _reflections.end()) {
+		throw std::invalid_argument("SHADER: Program was not created by Shader::createProgram!");
+	}
+	return it->second;
+}
+
+Shader::Reflection Shader::reflect(const GLuint program) {
+	auto reflection = Reflection{};
+	reflection.locations.fill(-1);
+
+	GLint maxNameLength;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+	GLint maxBlockNameLength;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockNameLength);
+	auto name = std::vector<char>(static_cast<std::size_t>(std::max(maxNameLength, maxBlockNameLength)) + 1);
+
+	// Default block uniforms, block members have no location and are skipped
+	GLint uniformCount;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+	for (auto i = 0; i < uniformCount; ++i) {
+		GLsizei length;
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(
+			program, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()),
+			&length, &size, &type, name.data()
+		);
+		const auto uniformName = std::string(name.data(), static_cast<std::size_t>(length));
+		const auto location = glGetUniformLocation(program, uniformName.c_str());
+		if (location < 0) {
+			continue;
+		}
+
+		for (std::size_t u = 0; u < UNIFORM_NAMES.size(); ++u) {
+			if (UNIFORM_NAMES[u] == uniformName) {
+				reflection.locations[u] = location;
+			}
+		}
+		reflection.uniforms.emplace_back(uniformName, location, type, size);
+	}
+
+	// Uniform blocks, the known ones get bound to their fixed binding point
+	GLint blockCount;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	for (auto i = 0; i < blockCount; ++i) {
+		const auto index = static_cast<GLuint>(i);
+		GLsizei length;
+		glGetActiveUniformBlockName(program, index, static_cast<GLsizei>(name.size()), &length, name.data());
+		GLint dataSize;
+		glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+		const auto blockName = std::string(name.data(), static_cast<std::size_t>(length));
+
+		for (std::size_t b = 0; b < BLOCK_NAMES.size(); ++b) {
+			if (BLOCK_NAMES[b] == blockName) {
+				glUniformBlockBinding(program, index, getBinding(static_cast<UniformBlock>(b)));
+			}
+		}
+		reflection.blocks.emplace_back(blockName, index, dataSize);
+	}
+
+	return reflection;
+}
+
 
 std::vector<char> Shader::readShaderFile(const std::string_view uri) {
 	auto file = std::ifstream(uri.data(), std::ios::ate);
@@ -1,18 +1,76 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <array>
+#include <string>
 #include <vector>
 #include <string_view>
+#include <unordered_map>
 
 class Shader {
 public:
-	static [[nodiscard]] GLuint createProgram(
+	// Uniforms the engine sets per draw, resolved once at link time.
+	enum class Uniform {
+		MODEL,
+		COUNT
+	};
+
+	// Uniform blocks the engine feeds, each one bound to a fixed binding point.
+	enum class UniformBlock {
+		FRAME,
+		COUNT
+	};
+
+	struct ActiveUniform {
+		std::string name;
+		GLint location;
+		GLenum type;
+		GLint size;
+	};
+
+	struct ActiveBlock {
+		std::string name;
+		GLuint index;
+		GLint dataSize;
+	};
+
+	struct Reflection {
+		std::array<GLint, static_cast<std::size_t>(Uniform::COUNT)> locations;
+		std::vector<ActiveUniform> uniforms;
+		std::vector<ActiveBlock> blocks;
+
+		[[nodiscard]] GLint operator[](Uniform uniform) const {
+			return locations[static_cast<std::size_t>(uniform)];
+		}
+	};
+
+	[[nodiscard]] static GLuint createProgram(
 		std::string_view vertexShaderUri,
 		std::string_view fragmentShaderUri
 	);
 
+	// The reflection of a program created by createProgram, meant to be queried
+	// when a program gets bound rather than on every draw.
+	[[nodiscard]] static const Reflection& getReflection(GLuint program);
+
+	[[nodiscard]] static constexpr GLuint getBinding(UniformBlock block) {
+		return static_cast<GLuint>(block);
+	}
+
 private:
-	static [[nodiscard]] std::vector<char> readShaderFile(std::string_view uri);
+	[[nodiscard]] static std::vector<char> readShaderFile(std::string_view uri);
 
 	static void validateShaderCompilation(GLuint shader);
-};
\ No newline at end of file
+
+	[[nodiscard]] static Reflection reflect(GLuint program);
+
+	inline static std::unordered_map<GLuint, Reflection> _reflections{};
+
+	static constexpr std::array<std::string_view, static_cast<std::size_t>(Uniform::COUNT)> UNIFORM_NAMES{
+		"model"
+	};
+
+	static constexpr std::array<std::string_view, static_cast<std::size_t>(UniformBlock::COUNT)> BLOCK_NAMES{
+		"Frame"
+	};
+};
@@ -0,0 +1,87 @@
+#include <stdexcept>
+
+#include "StreamBuffer.h"
+
+StreamBuffer::StreamBuffer(const std::size_t regionBytes, const std::size_t regionCount)
+	: _regionBytes{ regionBytes }, _fences(regionCount, nullptr), _region{ regionCount - 1 } {
+	if (regionBytes == 0 || regionCount == 0) {
+		throw std::invalid_argument("A stream buffer needs at least one non-empty region.");
+	}
+
+	// Coherent, so whatever the CPU writes is visible to commands issued after it without a flush
+	constexpr auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const auto size = static_cast<GLsizeiptr>(regionBytes * regionCount);
+
+	glGenBuffers(1, &_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+	_memory = static_cast<std::byte*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (!_memory) {
+		glDeleteBuffers(1, &_buffer);
+		throw std::runtime_error("Failed to persistently map a stream buffer.");
+	}
+}
+
+StreamBuffer::~StreamBuffer() {
+	for (const auto fence : _fences) {
+		if (fence) {
+			glDeleteSync(fence);
+		}
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &_buffer);
+}
+
+std::span<std::byte> StreamBuffer::map() {
+	// Nothing issued from now on reads the current region, so this fence covers all its readers
+	if (_fences[_region]) {
+		glDeleteSync(_fences[_region]);
+	}
+	_fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	_region = (_region + 1) % _fences.size();
+	if (const auto fence = _fences[_region]) {
+		wait(fence);
+		glDeleteSync(fence);
+		_fences[_region] = nullptr;
+	}
+
+	return { _memory + getOffset(), _regionBytes };
+}
+
+std::size_t StreamBuffer::getOffset() const {
+	return _region * _regionBytes;
+}
+
+GLuint StreamBuffer::getBuffer() const {
+	return _buffer;
+}
+
+std::size_t StreamBuffer::getRegionBytes() const {
+	return _regionBytes;
+}
+
+std::size_t StreamBuffer::getRegionCount() const {
+	return _fences.size();
+}
+
+void StreamBuffer::wait(const GLsync fence) {
+	// Flush on the first try only, in case the fence is still sitting in the command queue
+	auto flags = GLbitfield{ GL_SYNC_FLUSH_COMMANDS_BIT };
+	constexpr auto timeout = GLuint64{ 1'000'000 };	// in nanoseconds
+	while (true) {
+		const auto result = glClientWaitSync(fence, flags, timeout);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+			return;
+		}
+		if (result == GL_WAIT_FAILED) {
+			throw std::runtime_error("Failed to wait for a stream buffer region.");
+		}
+		flags = 0;
+	}
+}
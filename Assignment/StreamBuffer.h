@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// A persistently mapped buffer split into regions the CPU writes in turn while the GPU reads the
+// regions written before. Each region is fenced when the CPU moves past it, so it is only written
+// again once the GPU has finished every command issued up to then.
+class StreamBuffer {
+public:
+	explicit StreamBuffer(std::size_t regionBytes, std::size_t regionCount = DEFAULT_REGION_COUNT);
+	~StreamBuffer();
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer(StreamBuffer&&) noexcept = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(StreamBuffer&&) noexcept = delete;
+
+	// Moves on to the next region and returns its memory, waiting for the GPU if it still reads it.
+	[[nodiscard]] std::span<std::byte> map();
+
+	// The byte offset of the region last returned by map.
+	[[nodiscard]] std::size_t getOffset() const;
+
+	[[nodiscard]] GLuint getBuffer() const;
+
+	[[nodiscard]] std::size_t getRegionBytes() const;
+
+	[[nodiscard]] std::size_t getRegionCount() const;
+
+	// Lets the CPU write frame N+2 while the GPU still reads frame N.
+	static constexpr std::size_t DEFAULT_REGION_COUNT = 3;
+
+private:
+	GLuint _buffer{ 0 };
+
+	std::byte* _memory{ nullptr };
+
+	std::size_t _regionBytes;
+
+	std::vector<GLsync> _fences;
+
+	std::size_t _region;
+
+	static void wait(GLsync fence);
+};
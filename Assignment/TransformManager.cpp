@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <execution>
+#include <format>
+#include <stdexcept>
+
+#include "TransformManager.h"
+#include "Engine.h"
+
+void TransformManager::create(const Entity entity, const glm::mat4& local, const std::optional<Entity> parent) {
+	if (_instances.contains(entity)) {
+		throw std::invalid_argument(std::format("Entity {} already has a transform.\n", entity));
+	}
+	const auto parentInstance = parent ? getInstance(*parent) : NONE;
+
+	const auto instance = static_cast<Instance>(_entities.size());
+	_instances.emplace(entity, instance);
+	_entities.push_back(entity);
+	_local.push_back(local);
+	_world.push_back(local);
+	_parent.push_back(NONE);
+	_firstChild.push_back(NONE);
+	_nextSibling.push_back(NONE);
+	_previousSibling.push_back(NONE);
+	_dirty.push_back(0);
+
+	if (parentInstance != NONE) {
+		link(instance, parentInstance);
+	}
+	markDirty(instance);
+}
+
+void TransformManager::destroy(const Entity entity) {
+	const auto it = _instances.find(entity);
+	if (it == _instances.end()) {
+		return;
+	}
+	const auto instance = it->second;
+	_instances.erase(it);
+
+	// hand the children over before the links go
+	const auto parent = _parent[instance];
+	while (_firstChild[instance] != NONE) {
+		const auto child = _firstChild[instance];
+		unlink(child);
+		if (parent != NONE) {
+			link(child, parent);
+		}
+		markDirty(child);
+	}
+	unlink(instance);
+
+	// Swap with the last component to keep the arrays packed, pointing its relatives at its new place
+	const auto last = static_cast<Instance>(_entities.size() - 1);
+	if (instance != last) {
+		_entities[instance] = _entities[last];
+		_local[instance] = _local[last];
+		_world[instance] = _world[last];
+		_parent[instance] = _parent[last];
+		_firstChild[instance] = _firstChild[last];
+		_nextSibling[instance] = _nextSibling[last];
+		_previousSibling[instance] = _previousSibling[last];
+		_dirty[instance] = _dirty[last];
+		_instances[_entities[instance]] = instance;
+
+		if (const auto moved = _parent[instance]; moved != NONE && _firstChild[moved] == last) {
+			_firstChild[moved] = instance;
+		}
+		if (const auto previous = _previousSibling[instance]; previous != NONE) {
+			_nextSibling[previous] = instance;
+		}
+		if (const auto next = _nextSibling[instance]; next != NONE) {
+			_previousSibling[next] = instance;
+		}
+		for (auto child = _firstChild[instance]; child != NONE; child = _nextSibling[child]) {
+			_parent[child] = instance;
+		}
+	}
+	_entities.pop_back();
+	_local.pop_back();
+	_world.pop_back();
+	_parent.pop_back();
+	_firstChild.pop_back();
+	_nextSibling.pop_back();
+	_previousSibling.pop_back();
+	_dirty.pop_back();
+
+	// the renderer draws the entity at the origin from now on, so its bounds go there as well
+	updateScenes(entity);
+}
+
+bool TransformManager::hasComponent(const Entity entity) const {
+	return _instances.contains(entity);
+}
+
+std::size_t TransformManager::getComponentCount() const {
+	return _entities.size();
+}
+
+void TransformManager::setParent(const Entity entity, const std::optional<Entity> parent) {
+	const auto instance = getInstance(entity);
+	const auto parentInstance = parent ? getInstance(*parent) : NONE;
+	for (auto ancestor = parentInstance; ancestor != NONE; ancestor = _parent[ancestor]) {
+		if (ancestor == instance) {
+			throw std::invalid_argument(std::format("Entity {} cannot be parented under itself.\n", entity));
+		}
+	}
+
+	unlink(instance);
+	if (parentInstance != NONE) {
+		link(instance, parentInstance);
+	}
+	markDirty(instance);
+}
+
+std::optional<Entity> TransformManager::getParent(const Entity entity) const {
+	const auto parent = _parent[getInstance(entity)];
+	return parent == NONE ? std::nullopt : std::optional{ _entities[parent] };
+}
+
+void TransformManager::setTransform(const Entity entity, const glm::mat4& local) {
+	const auto instance = getInstance(entity);
+	_local[instance] = local;
+	markDirty(instance);
+}
+
+const glm::mat4& TransformManager::getTransform(const Entity entity) const {
+	return _local[getInstance(entity)];
+}
+
+const glm::mat4& TransformManager::getWorldTransform(const Entity entity) const {
+	return _world[getInstance(entity)];
+}
+
+void TransformManager::update() {
+	_changed.clear();
+	_ranges.clear();
+
+	// Only the flagged transforms without a flagged ancestor start a walk, the others come along with it
+	auto roots = std::vector<Instance>{};
+	for (const auto entity : _dirtyList) {
+		const auto it = _instances.find(entity);
+		if (it == _instances.end() || !_dirty[it->second]) {
+			continue;
+		}
+		auto root = true;
+		for (auto ancestor = _parent[it->second]; ancestor != NONE; ancestor = _parent[ancestor]) {
+			if (_dirty[ancestor]) {
+				root = false;
+				break;
+			}
+		}
+		if (root) {
+			roots.push_back(it->second);
+		}
+	}
+	_dirtyList.clear();
+
+	// a component destroyed and created again within a frame is flagged twice
+	std::ranges::sort(roots);
+	const auto [first, last] = std::ranges::unique(roots);
+	roots.erase(first, last);
+
+	// Lay each subtree out depth first, so every parent comes before its children within its range
+	for (const auto root : roots) {
+		const auto start = _changed.size();
+		_changed.push_back(root);
+		auto node = _firstChild[root];
+		while (node != NONE) {
+			_changed.push_back(node);
+			if (_firstChild[node] != NONE) {
+				node = _firstChild[node];
+				continue;
+			}
+			while (node != root && _nextSibling[node] == NONE) {
+				node = _parent[node];
+			}
+			node = node == root ? NONE : _nextSibling[node];
+		}
+		_ranges.emplace_back(start, _changed.size());
+	}
+
+	// The parent of a root is untouched by this update, and the subtrees do not overlap,
+	// so they can go in any order, on any thread
+	const auto updateRange = [this](const std::pair<std::size_t, std::size_t>& range) {
+		for (auto k = range.first; k < range.second; ++k) {
+			const auto instance = _changed[k];
+			const auto parent = _parent[instance];
+			_world[instance] = parent == NONE ? _local[instance] : _world[parent] * _local[instance];
+			_dirty[instance] = 0;
+		}
+	};
+	if (_changed.size() >= PARALLEL_COUNT && _ranges.size() > 1) {
+		std::for_each(std::execution::par, _ranges.begin(), _ranges.end(), updateRange);
+	} else {
+		std::ranges::for_each(_ranges, updateRange);
+	}
+}
+
+TransformManager::Instance TransformManager::getInstance(const Entity entity) const {
+	const auto it = _instances.find(entity);
+	if (it == _instances.end()) {
+		throw std::invalid_argument(std::format("Entity {} has no transform.\n", entity));
+	}
+	return it->second;
+}
+
+const glm::mat4* TransformManager::findWorldTransform(const Entity entity) const {
+	const auto it = _instances.find(entity);
+	return it == _instances.end() ? nullptr : &_world[it->second];
+}
+
+void TransformManager::markDirty(const Instance instance) {
+	if (!_dirty[instance]) {
+		_dirty[instance] = 1;
+		_dirtyList.push_back(_entities[instance]);
+	}
+}
+
+void TransformManager::link(const Instance instance, const Instance parent) {
+	_parent[instance] = parent;
+	_previousSibling[instance] = NONE;
+	_nextSibling[instance] = _firstChild[parent];
+	if (_firstChild[parent] != NONE) {
+		_previousSibling[_firstChild[parent]] = instance;
+	}
+	_firstChild[parent] = instance;
+}
+
+void TransformManager::unlink(const Instance instance) {
+	const auto parent = _parent[instance];
+	const auto previous = _previousSibling[instance];
+	const auto next = _nextSibling[instance];
+	if (previous != NONE) {
+		_nextSibling[previous] = next;
+	} else if (parent != NONE) {
+		_firstChild[parent] = next;
+	}
+	if (next != NONE) {
+		_previousSibling[next] = previous;
+	}
+	_parent[instance] = NONE;
+	_previousSibling[instance] = NONE;
+	_nextSibling[instance] = NONE;
+}
+
+void TransformManager::updateScenes(const Entity entity) const {
+	for (const auto scene : _engine._scenes) {
+		if (const auto it = scene->_indices.find(entity); it != scene->_indices.end()) {
+			scene->updateBounds(it->second);
+		}
+	}
+}
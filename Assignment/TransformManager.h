@@ -0,0 +1,103 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "EntityManager.h"
+
+class Engine;
+
+// The transforms of entities, relative to their parent if they have one, with the world transforms
+// they add up to. Components sit in parallel arrays, the hierarchy linked through them by index.
+// Setting a transform only flags it, the engine brings the world transforms of everything flagged and
+// everything under it up to date once per frame, so a frame costs as much as what moved in it.
+class TransformManager {
+public:
+	void create(Entity entity, const glm::mat4& local = glm::mat4{ 1.0f }, std::optional<Entity> parent = std::nullopt);
+
+	// The children of the entity go to its parent, keeping their own transforms, and move along in the scenes
+	// with the next update. Scenes holding the entity take it back to the origin of the world right away.
+	void destroy(Entity entity);
+
+	[[nodiscard]] bool hasComponent(Entity entity) const;
+
+	[[nodiscard]] std::size_t getComponentCount() const;
+
+	// Throws if the parent is the entity or somewhere under it.
+	void setParent(Entity entity, std::optional<Entity> parent);
+
+	[[nodiscard]] std::optional<Entity> getParent(Entity entity) const;
+
+	void setTransform(Entity entity, const glm::mat4& local);
+
+	[[nodiscard]] const glm::mat4& getTransform(Entity entity) const;
+
+	// As of the last time the engine updated the transforms.
+	[[nodiscard]] const glm::mat4& getWorldTransform(Entity entity) const;
+
+	friend class Engine;
+
+	friend class Renderer;
+
+	friend class Scene;
+
+private:
+	explicit TransformManager(Engine& engine) : _engine{ engine } {}
+
+	using Instance = std::uint32_t;
+
+	static constexpr auto NONE = std::numeric_limits<Instance>::max();
+
+	// From how many transforms to update the subtrees are spread over worker threads.
+	static constexpr std::size_t PARALLEL_COUNT = 4096;
+
+	// Recomputes the world transforms of everything flagged and everything under it, leaving what it
+	// went through in _changed.
+	void update();
+
+	[[nodiscard]] Instance getInstance(Entity entity) const;
+
+	// Nullptr for entities without a transform.
+	[[nodiscard]] const glm::mat4* findWorldTransform(Entity entity) const;
+
+	void markDirty(Instance instance);
+
+	void link(Instance instance, Instance parent);
+
+	void unlink(Instance instance);
+
+	// Brings the bounds of the entity up to date with its world transform in every scene holding it.
+	void updateScenes(Entity entity) const;
+
+	Engine& _engine;
+
+	std::unordered_map<Entity, Instance> _instances{};
+
+	std::vector<Entity> _entities{};
+
+	std::vector<glm::mat4> _local{};
+
+	std::vector<glm::mat4> _world{};
+
+	// NONE where there is no such relative.
+	std::vector<Instance> _parent{};
+	std::vector<Instance> _firstChild{};
+	std::vector<Instance> _nextSibling{};
+	std::vector<Instance> _previousSibling{};
+
+	std::vector<std::uint8_t> _dirty{};
+
+	// The entities flagged since the last update, by entity so destroying components does not leave them dangling.
+	std::vector<Entity> _dirtyList{};
+
+	// The subtrees the last update went through, each laid out parent first.
+	std::vector<Instance> _changed{};
+	std::vector<std::pair<std::size_t, std::size_t>> _ranges{};
+};
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <limits>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TRIANGLE_BVH_SSE
+#endif
+
+#include "TriangleBvh.h"
+#include "DynamicBvh.h"
+
+// Below this the ray runs along the plane of the triangle.
+static constexpr auto PARALLEL_EPSILON = 1e-12f;
+
+TriangleBvh::TriangleBvh(const std::span<const glm::vec3> positions, const std::span<const std::uint32_t> triangles) {
+	_triangleCount = triangles.size() / 3;
+	if (_triangleCount == 0) {
+		return;
+	}
+
+	auto boxes = std::vector<Triangle>(_triangleCount);
+	for (std::size_t t = 0; t < _triangleCount; ++t) {
+		const auto& a = positions[triangles[3 * t]];
+		const auto& b = positions[triangles[3 * t + 1]];
+		const auto& c = positions[triangles[3 * t + 2]];
+		const auto min = glm::min(a, glm::min(b, c));
+		const auto max = glm::max(a, glm::max(b, c));
+		boxes[t] = Triangle{ min, max, (min + max) * 0.5f, static_cast<std::uint32_t>(t) };
+	}
+
+	// a full binary tree over leaves of up to four has fewer than half as many nodes as triangles
+	_nodes.reserve(_triangleCount / 2 + 1);
+	_packets.reserve(_triangleCount / 2 + 1);
+	build(boxes, positions, triangles);
+}
+
+std::optional<TriangleBvh::Hit> TriangleBvh::intersect(
+	const glm::vec3& origin, const glm::vec3& direction, float maxDistance
+) const {
+	if (_nodes.empty()) {
+		return std::nullopt;
+	}
+
+	auto nearest = std::optional<Hit>{};
+	const auto inverse = 1.0f / direction;
+	auto stack = std::vector<std::uint32_t>{ 0 };
+	while (!stack.empty()) {
+		const auto index = stack.back();
+		stack.pop_back();
+
+		const auto& node = _nodes[index];
+		if (!DynamicBvh::intersectRay(origin, inverse, maxDistance, node.min, node.max)) {
+			continue;
+		}
+
+		if (node.count > 0) {
+			if (const auto hit = intersect(_packets[node.offset], origin, direction, maxDistance)) {
+				nearest = hit;
+				maxDistance = hit->distance;
+			}
+			continue;
+		}
+
+		// the nearer child goes on top, so its hits cut the search of the other one short
+		const auto left = index + 1;
+		const auto right = node.offset;
+		const auto leftEntry = DynamicBvh::intersectRay(origin, inverse, maxDistance, _nodes[left].min, _nodes[left].max);
+		const auto rightEntry = DynamicBvh::intersectRay(origin, inverse, maxDistance, _nodes[right].min, _nodes[right].max);
+		if (leftEntry && rightEntry) {
+			const auto leftFirst = *leftEntry <= *rightEntry;
+			stack.push_back(leftFirst ? right : left);
+			stack.push_back(leftFirst ? left : right);
+		} else if (leftEntry || rightEntry) {
+			stack.push_back(leftEntry ? left : right);
+		}
+	}
+	return nearest;
+}
+
+std::size_t TriangleBvh::getTriangleCount() const {
+	return _triangleCount;
+}
+
+void TriangleBvh::build(
+	const std::span<Triangle> triangles,
+	const std::span<const glm::vec3> positions,
+	const std::span<const std::uint32_t> indices
+) {
+	const auto index = _nodes.size();
+	auto min = triangles.front().min;
+	auto max = triangles.front().max;
+	auto centerMin = triangles.front().center;
+	auto centerMax = centerMin;
+	for (const auto& triangle : triangles) {
+		min = glm::min(min, triangle.min);
+		max = glm::max(max, triangle.max);
+		centerMin = glm::min(centerMin, triangle.center);
+		centerMax = glm::max(centerMax, triangle.center);
+	}
+	_nodes.push_back(Node{ min, max, 0, 0 });
+
+	if (triangles.size() <= LEAF_TRIANGLES) {
+		auto packet = Packet{};
+		for (std::size_t lane = 0; lane < triangles.size(); ++lane) {
+			const auto t = triangles[lane].index;
+			const auto& a = positions[indices[3 * t]];
+			const auto edge1 = positions[indices[3 * t + 1]] - a;
+			const auto edge2 = positions[indices[3 * t + 2]] - a;
+			packet.x[lane] = a.x;
+			packet.y[lane] = a.y;
+			packet.z[lane] = a.z;
+			packet.edge1X[lane] = edge1.x;
+			packet.edge1Y[lane] = edge1.y;
+			packet.edge1Z[lane] = edge1.z;
+			packet.edge2X[lane] = edge2.x;
+			packet.edge2Y[lane] = edge2.y;
+			packet.edge2Z[lane] = edge2.z;
+			packet.triangle[lane] = t;
+		}
+		_nodes[index].offset = static_cast<std::uint32_t>(_packets.size());
+		_nodes[index].count = static_cast<std::uint32_t>(triangles.size());
+		_packets.push_back(packet);
+		return;
+	}
+
+	// split along the axis the centers spread the most over, between the bins where the areas weighted
+	// by the triangle counts on either side add up the least, or in the middle if they all share a center
+	const auto spread = centerMax - centerMin;
+	const auto axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+	const auto area = [](const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		const auto extent = boxMax - boxMin;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	};
+
+	auto middle = triangles.size() / 2;
+	auto split = std::optional<int>{};
+	if (spread[axis] > 0.0f) {
+		const auto binOf = [&](const Triangle& triangle) {
+			const auto bin = static_cast<int>((triangle.center[axis] - centerMin[axis]) / spread[axis] * SAH_BINS);
+			return std::min(bin, SAH_BINS - 1);
+		};
+
+		struct Bin {
+			glm::vec3 min{ std::numeric_limits<float>::max() };
+			glm::vec3 max{ std::numeric_limits<float>::lowest() };
+			std::size_t count{ 0 };
+		};
+		auto bins = std::array<Bin, SAH_BINS>{};
+		for (const auto& triangle : triangles) {
+			auto& bin = bins[binOf(triangle)];
+			bin.min = glm::min(bin.min, triangle.min);
+			bin.max = glm::max(bin.max, triangle.max);
+			++bin.count;
+		}
+
+		auto rightCosts = std::array<float, SAH_BINS>{};
+		auto sweep = Bin{};
+		for (auto b = SAH_BINS - 1; b > 0; --b) {
+			sweep.min = glm::min(sweep.min, bins[b].min);
+			sweep.max = glm::max(sweep.max, bins[b].max);
+			sweep.count += bins[b].count;
+			rightCosts[b] = sweep.count == 0 ? 0.0f : area(sweep.min, sweep.max) * static_cast<float>(sweep.count);
+		}
+
+		auto bestCost = std::numeric_limits<float>::max();
+		sweep = Bin{};
+		for (auto b = 1; b < SAH_BINS; ++b) {
+			sweep.min = glm::min(sweep.min, bins[b - 1].min);
+			sweep.max = glm::max(sweep.max, bins[b - 1].max);
+			sweep.count += bins[b - 1].count;
+			if (sweep.count == 0 || sweep.count == triangles.size()) {
+				continue;
+			}
+			const auto cost = area(sweep.min, sweep.max) * static_cast<float>(sweep.count) + rightCosts[b];
+			if (cost < bestCost) {
+				bestCost = cost;
+				split = b;
+			}
+		}
+
+		if (split) {
+			const auto right = std::partition(triangles.begin(), triangles.end(), [&](const auto& triangle) {
+				return binOf(triangle) < *split;
+			});
+			middle = static_cast<std::size_t>(right - triangles.begin());
+		}
+	}
+	if (!split) {
+		std::ranges::nth_element(triangles, triangles.begin() + static_cast<std::ptrdiff_t>(middle), {}, [axis](const auto& triangle) {
+			return triangle.center[axis];
+		});
+	}
+
+	build(triangles.first(middle), positions, indices);
+	_nodes[index].offset = static_cast<std::uint32_t>(_nodes.size());
+	build(triangles.subspan(middle), positions, indices);
+}
+
+std::optional<TriangleBvh::Hit> TriangleBvh::intersect(
+	const Packet& packet, const glm::vec3& origin, const glm::vec3& direction, const float maxDistance
+) {
+	// Moller-Trumbore for all four lanes at once, then the nearest lane that passed every test
+	auto distances = std::array<float, LEAF_TRIANGLES>{};
+	auto hits = std::array<bool, LEAF_TRIANGLES>{};
+
+#ifdef TRIANGLE_BVH_SSE
+	const auto dx = _mm_set1_ps(direction.x);
+	const auto dy = _mm_set1_ps(direction.y);
+	const auto dz = _mm_set1_ps(direction.z);
+	const auto e1x = _mm_load_ps(packet.edge1X.data());
+	const auto e1y = _mm_load_ps(packet.edge1Y.data());
+	const auto e1z = _mm_load_ps(packet.edge1Z.data());
+	const auto e2x = _mm_load_ps(packet.edge2X.data());
+	const auto e2y = _mm_load_ps(packet.edge2Y.data());
+	const auto e2z = _mm_load_ps(packet.edge2Z.data());
+
+	const auto px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	const auto py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	const auto pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	const auto det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	const auto inverse = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+	const auto tx = _mm_sub_ps(_mm_set1_ps(origin.x), _mm_load_ps(packet.x.data()));
+	const auto ty = _mm_sub_ps(_mm_set1_ps(origin.y), _mm_load_ps(packet.y.data()));
+	const auto tz = _mm_sub_ps(_mm_set1_ps(origin.z), _mm_load_ps(packet.z.data()));
+	const auto u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverse);
+
+	const auto qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	const auto qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	const auto qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+	const auto v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverse);
+	const auto t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse);
+
+	const auto zero = _mm_setzero_ps();
+	auto mask = _mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), det), _mm_set1_ps(PARALLEL_EPSILON));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+	mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+	mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(maxDistance)));
+
+	_mm_storeu_ps(distances.data(), t);
+	const auto bits = _mm_movemask_ps(mask);
+	for (auto lane = 0; lane < LEAF_TRIANGLES; ++lane) {
+		hits[lane] = (bits >> lane & 1) != 0;
+	}
+#else
+	for (auto lane = 0; lane < LEAF_TRIANGLES; ++lane) {
+		const auto edge1 = glm::vec3{ packet.edge1X[lane], packet.edge1Y[lane], packet.edge1Z[lane] };
+		const auto edge2 = glm::vec3{ packet.edge2X[lane], packet.edge2Y[lane], packet.edge2Z[lane] };
+		const auto p = glm::cross(direction, edge2);
+		const auto det = glm::dot(edge1, p);
+		if (std::abs(det) <= PARALLEL_EPSILON) {
+			continue;
+		}
+		const auto inverse = 1.0f / det;
+		const auto toOrigin = origin - glm::vec3{ packet.x[lane], packet.y[lane], packet.z[lane] };
+		const auto u = glm::dot(toOrigin, p) * inverse;
+		const auto q = glm::cross(toOrigin, edge1);
+		const auto v = glm::dot(direction, q) * inverse;
+		distances[lane] = glm::dot(edge2, q) * inverse;
+		hits[lane] = u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distances[lane] > 0.0f && distances[lane] < maxDistance;
+	}
+#endif
+
+	auto nearest = std::optional<Hit>{};
+	for (auto lane = 0; lane < LEAF_TRIANGLES; ++lane) {
+		if (hits[lane] && (!nearest || distances[lane] < nearest->distance)) {
+			nearest = Hit{ distances[lane], packet.triangle[lane] };
+		}
+	}
+	return nearest;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// A bounding volume hierarchy over the triangles of a mesh, for casting rays against its surface.
+// Built once, top down with the surface area heuristic, into leaves of up to four triangles laid out
+// side by side, so a leaf is tested against the ray in one go where SSE is available.
+class TriangleBvh {
+public:
+	// Three vertex indices per triangle.
+	TriangleBvh(std::span<const glm::vec3> positions, std::span<const std::uint32_t> triangles);
+
+	struct Hit {
+		float distance;
+		std::uint32_t triangle;		// in the order the triangles were given
+	};
+
+	// The nearest triangle the ray hits within the distance, from either side, measured in lengths of the direction.
+	[[nodiscard]] std::optional<Hit> intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+	[[nodiscard]] std::size_t getTriangleCount() const;
+
+	static constexpr auto LEAF_TRIANGLES = 4;
+
+private:
+	// Nodes are laid out depth first, so the left child of an inner node is right after it.
+	struct Node {
+		glm::vec3 min;
+		glm::vec3 max;
+		std::uint32_t offset;	// the right child of an inner node, the packet of a leaf
+		std::uint32_t count;	// the triangles of a leaf, 0 for inner nodes
+	};
+
+	// The triangles of a leaf as a corner and two edges, one array per component. Unused lanes keep
+	// empty edges, which no ray can hit.
+	struct alignas(16) Packet {
+		std::array<float, LEAF_TRIANGLES> x, y, z;
+		std::array<float, LEAF_TRIANGLES> edge1X, edge1Y, edge1Z;
+		std::array<float, LEAF_TRIANGLES> edge2X, edge2Y, edge2Z;
+		std::array<std::uint32_t, LEAF_TRIANGLES> triangle;
+	};
+
+	struct Triangle {
+		glm::vec3 min;
+		glm::vec3 max;
+		glm::vec3 center;
+		std::uint32_t index;
+	};
+
+	static constexpr auto SAH_BINS = 16;
+
+	void build(std::span<Triangle> triangles, std::span<const glm::vec3> positions, std::span<const std::uint32_t> indices);
+
+	// Where the ray first hits one of the packet's triangles, if nearer than the distance.
+	[[nodiscard]] static std::optional<Hit> intersect(
+		const Packet& packet, const glm::vec3& origin, const glm::vec3& direction, float maxDistance
+	);
+
+	std::vector<Node> _nodes{};
+
+	std::vector<Packet> _packets{};
+
+	std::size_t _triangleCount{ 0 };
+};
@@ -1,4 +1,3 @@
-
 #include "View.h"
 
 void View::setScene(Scene* const scene) {
@@ -9,3 +8,18 @@ Scene* View::getScene() const {
 	return _scene;
 }
 
+void View::setCamera(Camera* const camera) {
+	_camera = camera;
+}
+
+Camera* View::getCamera() const {
+	return _camera;
+}
+
+void View::setLayerMask(const std::uint8_t mask) {
+	_layerMask = mask;
+}
+
+std::uint8_t View::getLayerMask() const {
+	return _layerMask;
+}
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
+
 #include "Scene.h"
+#include "Camera.h"
 
 class View {
 public:
@@ -8,6 +11,19 @@ public:
 
 	[[nodiscard]] Scene* getScene() const;
 
+	void setCamera(Camera* camera);
+
+	[[nodiscard]] Camera* getCamera() const;
+
+	// The layers the view shows, entities in none of them are skipped.
+	void setLayerMask(std::uint8_t mask);
+
+	[[nodiscard]] std::uint8_t getLayerMask() const;
+
 private:
 	Scene* _scene{ nullptr };
-};
\ No newline at end of file
+
+	Camera* _camera{ nullptr };
+
+	std::uint8_t _layerMask{ 0xFF };
+};
@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <format>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+
+#include "HeightExpression.h"
+
+using OpCode = HeightExpression::OpCode;
+
+// Calls visitor.operator()<Op>() with the op code as a template argument, so every operation
+// gets its own copy of whatever loop the visitor runs, with the arithmetic inlined.
+template<typename Visitor>
+static void dispatch(const OpCode op, Visitor&& visitor) {
+	switch (op) {
+	case OpCode::NEGATE:	visitor.template operator()<OpCode::NEGATE>(); break;
+	case OpCode::SIN:		visitor.template operator()<OpCode::SIN>(); break;
+	case OpCode::COS:		visitor.template operator()<OpCode::COS>(); break;
+	case OpCode::TAN:		visitor.template operator()<OpCode::TAN>(); break;
+	case OpCode::SQRT:		visitor.template operator()<OpCode::SQRT>(); break;
+	case OpCode::ABS:		visitor.template operator()<OpCode::ABS>(); break;
+	case OpCode::EXP:		visitor.template operator()<OpCode::EXP>(); break;
+	case OpCode::LOG:		visitor.template operator()<OpCode::LOG>(); break;
+	case OpCode::FLOOR:		visitor.template operator()<OpCode::FLOOR>(); break;
+	case OpCode::ADD:		visitor.template operator()<OpCode::ADD>(); break;
+	case OpCode::SUBTRACT:	visitor.template operator()<OpCode::SUBTRACT>(); break;
+	case OpCode::MULTIPLY:	visitor.template operator()<OpCode::MULTIPLY>(); break;
+	case OpCode::DIVIDE:	visitor.template operator()<OpCode::DIVIDE>(); break;
+	case OpCode::POWER:		visitor.template operator()<OpCode::POWER>(); break;
+	case OpCode::MIN:		visitor.template operator()<OpCode::MIN>(); break;
+	case OpCode::MAX:		visitor.template operator()<OpCode::MAX>(); break;
+	default:
+		throw std::invalid_argument("Not an arithmetic op code.");
+	}
+}
+
+template<OpCode Op>
+static float apply(const float a, const float b) {
+	if constexpr (Op == OpCode::NEGATE) return -a;
+	else if constexpr (Op == OpCode::SIN) return std::sin(a);
+	else if constexpr (Op == OpCode::COS) return std::cos(a);
+	else if constexpr (Op == OpCode::TAN) return std::tan(a);
+	else if constexpr (Op == OpCode::SQRT) return std::sqrt(a);
+	else if constexpr (Op == OpCode::ABS) return std::abs(a);
+	else if constexpr (Op == OpCode::EXP) return std::exp(a);
+	else if constexpr (Op == OpCode::LOG) return std::log(a);
+	else if constexpr (Op == OpCode::FLOOR) return std::floor(a);
+	else if constexpr (Op == OpCode::ADD) return a + b;
+	else if constexpr (Op == OpCode::SUBTRACT) return a - b;
+	else if constexpr (Op == OpCode::MULTIPLY) return a * b;
+	else if constexpr (Op == OpCode::DIVIDE) return a / b;
+	else if constexpr (Op == OpCode::POWER) return std::pow(a, b);
+	else if constexpr (Op == OpCode::MIN) return std::min(a, b);
+	else return std::max(a, b);
+}
+
+// Recursive descent over the grammar below, building a tree which gets constant-folded on the way
+// and then flattened into bytecode.
+//   expression := term (('+' | '-') term)*
+//   term       := unary (('*' | '/') unary)*
+//   unary      := '-' unary | power
+//   power      := primary ('^' unary)?
+//   primary    := number | name | name '(' expression (',' expression)* ')' | '(' expression ')'
+class HeightExpression::Parser {
+public:
+	explicit Parser(const std::string_view source) : _source{ source } {}
+
+	struct Node {
+		OpCode op;
+		float constant;
+		int left;
+		int right;
+	};
+
+	int parse() {
+		const auto root = expression();
+		skipSpaces();
+		if (_position < _source.size()) {
+			fail("unexpected character");
+		}
+		return root;
+	}
+
+	[[nodiscard]] const std::vector<Node>& nodes() const {
+		return _nodes;
+	}
+
+private:
+	const std::string_view _source;
+
+	std::size_t _position{ 0 };
+
+	std::vector<Node> _nodes{};
+
+	int expression() {
+		auto node = term();
+		while (true) {
+			if (accept('+')) {
+				node = binary(OpCode::ADD, node, term());
+			} else if (accept('-')) {
+				node = binary(OpCode::SUBTRACT, node, term());
+			} else {
+				return node;
+			}
+		}
+	}
+
+	int term() {
+		auto node = unary();
+		while (true) {
+			if (accept('*')) {
+				node = binary(OpCode::MULTIPLY, node, unary());
+			} else if (accept('/')) {
+				node = binary(OpCode::DIVIDE, node, unary());
+			} else {
+				return node;
+			}
+		}
+	}
+
+	int unary() {
+		if (accept('-')) {
+			return binary(OpCode::NEGATE, unary(), -1);
+		}
+		return power();
+	}
+
+	int power() {
+		const auto base = primary();
+		// right associative, 2^3^2 is 2^9
+		if (accept('^')) {
+			return binary(OpCode::POWER, base, unary());
+		}
+		return base;
+	}
+
+	int primary() {
+		skipSpaces();
+		if (accept('(')) {
+			const auto node = expression();
+			expect(')');
+			return node;
+		}
+
+		if (_position < _source.size() && (std::isdigit(_source[_position]) || _source[_position] == '.')) {
+			auto value = 0.0f;
+			const auto begin = _source.data() + _position;
+			const auto [end, error] = std::from_chars(begin, _source.data() + _source.size(), value);
+			if (error != std::errc{}) {
+				fail("malformed number");
+			}
+			_position += static_cast<std::size_t>(end - begin);
+			return constant(value);
+		}
+
+		const auto name = identifier();
+		if (name == "x") return leaf(OpCode::X);
+		if (name == "y") return leaf(OpCode::Y);
+		if (name == "t") return leaf(OpCode::TIME);
+		if (name == "pi") return constant(std::numbers::pi_v<float>);
+		if (name == "e") return constant(std::numbers::e_v<float>);
+
+		constexpr auto functions = std::array{
+			std::pair{ "sin", OpCode::SIN }, std::pair{ "cos", OpCode::COS }, std::pair{ "tan", OpCode::TAN },
+			std::pair{ "sqrt", OpCode::SQRT }, std::pair{ "abs", OpCode::ABS }, std::pair{ "exp", OpCode::EXP },
+			std::pair{ "log", OpCode::LOG }, std::pair{ "floor", OpCode::FLOOR },
+			std::pair{ "min", OpCode::MIN }, std::pair{ "max", OpCode::MAX }, std::pair{ "pow", OpCode::POWER },
+		};
+		const auto function = std::ranges::find(functions, name, [](const auto& entry) { return std::string_view{ entry.first }; });
+		if (function == functions.end()) {
+			fail(std::format("unknown name '{}'", name));
+		}
+
+		const auto op = function->second;
+		expect('(');
+		const auto first = expression();
+		auto second = -1;
+		if (op >= OpCode::ADD) {
+			expect(',');
+			second = expression();
+		}
+		expect(')');
+		return binary(op, first, second);
+	}
+
+	std::string_view identifier() {
+		skipSpaces();
+		const auto begin = _position;
+		while (_position < _source.size() && std::isalpha(_source[_position])) {
+			++_position;
+		}
+		if (begin == _position) {
+			fail("expected a number, a name or '('");
+		}
+		return _source.substr(begin, _position - begin);
+	}
+
+	int leaf(const OpCode op) {
+		_nodes.push_back(Node{ op, 0.0f, -1, -1 });
+		return static_cast<int>(_nodes.size() - 1);
+	}
+
+	int constant(const float value) {
+		_nodes.push_back(Node{ OpCode::CONSTANT, value, -1, -1 });
+		return static_cast<int>(_nodes.size() - 1);
+	}
+
+	int binary(const OpCode op, const int left, const int right) {
+		// Fold operations on constants right away, they never reach the bytecode
+		const auto isConstant = [this](const int node) { return node < 0 || _nodes[node].op == OpCode::CONSTANT; };
+		if (isConstant(left) && isConstant(right)) {
+			const auto a = _nodes[left].constant;
+			const auto b = right < 0 ? 0.0f : _nodes[right].constant;
+			auto value = 0.0f;
+			dispatch(op, [&]<OpCode Op>() { value = apply<Op>(a, b); });
+			return constant(value);
+		}
+		_nodes.push_back(Node{ op, 0.0f, left, right });
+		return static_cast<int>(_nodes.size() - 1);
+	}
+
+	void skipSpaces() {
+		while (_position < _source.size() && std::isspace(_source[_position])) {
+			++_position;
+		}
+	}
+
+	bool accept(const char c) {
+		skipSpaces();
+		if (_position < _source.size() && _source[_position] == c) {
+			++_position;
+			return true;
+		}
+		return false;
+	}
+
+	void expect(const char c) {
+		if (!accept(c)) {
+			fail(std::format("expected '{}'", c));
+		}
+	}
+
+	[[noreturn]] void fail(const std::string& message) const {
+		throw std::invalid_argument(std::format("Height expression: {} at position {}.", message, _position));
+	}
+};
+
+HeightExpression HeightExpression::compile(const std::string_view source) {
+	auto parser = Parser{ source };
+	const auto root = parser.parse();
+	const auto& nodes = parser.nodes();
+
+	// Evaluate each node into the register of its depth: the left operand stays in the target
+	// while the right one goes one register further, so a tree needs as many registers as it is deep
+	auto program = std::vector<Instruction>{};
+	auto usesTime = false;
+	const auto emit = [&](const auto& self, const int node, const std::size_t target) -> void {
+		if (target >= MAX_REGISTERS) {
+			throw std::invalid_argument("Height expression: nested too deeply.");
+		}
+
+		const auto& [op, constant, left, right] = nodes[node];
+		const auto reg = static_cast<std::uint8_t>(target);
+		if (left < 0) {
+			usesTime |= op == OpCode::TIME;
+			program.push_back(Instruction{ op, reg, reg, reg, constant });
+			return;
+		}
+
+		self(self, left, target);
+		if (right < 0) {
+			program.push_back(Instruction{ op, reg, reg, reg, 0.0f });
+			return;
+		}
+		self(self, right, target + 1);
+		program.push_back(Instruction{ op, reg, reg, static_cast<std::uint8_t>(target + 1), 0.0f });
+	};
+	emit(emit, root, 0);
+
+	return HeightExpression{ std::move(program), usesTime };
+}
+
+HeightExpression::HeightExpression(std::vector<Instruction> program, const bool usesTime)
+	: _program{ std::move(program) }, _usesTime{ usesTime } {}
+
+void HeightExpression::operator()(
+	const std::span<const float> xs,
+	const std::span<const float> ys,
+	const float time,
+	const std::span<float> zs
+) const {
+	// zero-initialized, the lanes past the end of the last block are computed but never read
+	auto registers = std::array<Block, MAX_REGISTERS>{};
+
+	for (std::size_t begin = 0; begin < zs.size(); begin += LANES) {
+		const auto count = std::min(LANES, zs.size() - begin);
+
+		for (const auto& [op, target, left, right, constant] : _program) {
+			auto& result = registers[target];
+			switch (op) {
+			case OpCode::CONSTANT:
+				result.fill(constant);
+				break;
+			case OpCode::TIME:
+				result.fill(time);
+				break;
+			case OpCode::X:
+				std::copy_n(xs.data() + begin, count, result.data());
+				break;
+			case OpCode::Y:
+				std::copy_n(ys.data() + begin, count, result.data());
+				break;
+			default: {
+				const auto& a = registers[left];
+				const auto& b = registers[right];
+				// fixed trip count over whole blocks, which the compiler unrolls into vector instructions
+				dispatch(op, [&]<OpCode Op>() {
+					for (std::size_t i = 0; i < LANES; ++i) {
+						result[i] = apply<Op>(a[i], b[i]);
+					}
+				});
+				break;
+			}
+			}
+		}
+
+		std::copy_n(registers[0].data(), count, zs.data() + begin);
+	}
+}
+
+bool HeightExpression::usesTime() const {
+	return _usesTime;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// A height function written as a math expression, such as "sin(x) + cos(y) * 0.5", compiled into
+// register bytecode. Every instruction runs over a block of LANES points at a time, so the loops
+// stay short and branch free and the compiler maps them onto SIMD registers.
+//
+// The expressions know the variables x, y and t, the constants pi and e, the operators + - * / ^
+// and the functions sin, cos, tan, sqrt, abs, exp, log, floor, min, max and pow.
+class HeightExpression {
+public:
+	// Throws std::invalid_argument, naming the position of the first error, if the source does not parse.
+	[[nodiscard]] static HeightExpression compile(std::string_view source);
+
+	// Evaluates zs[i] = f(xs[i], ys[i], time), in the batch shape BakedMesh::Builder accepts.
+	void operator()(std::span<const float> xs, std::span<const float> ys, float time, std::span<float> zs) const;
+
+	// Whether the expression depends on t at all.
+	[[nodiscard]] bool usesTime() const;
+
+	// The number of points every instruction processes at once.
+	static constexpr std::size_t LANES = 64;
+
+	// Deeper expressions are rejected, the registers of a block all live on the stack.
+	static constexpr std::size_t MAX_REGISTERS = 32;
+
+	enum class OpCode : std::uint8_t {
+		CONSTANT, X, Y, TIME,
+		NEGATE, SIN, COS, TAN, SQRT, ABS, EXP, LOG, FLOOR,
+		ADD, SUBTRACT, MULTIPLY, DIVIDE, POWER, MIN, MAX
+	};
+
+	// target = op(left, right), the operands a unary operation does not use are ignored.
+	struct Instruction {
+		OpCode op;
+		std::uint8_t target;
+		std::uint8_t left;
+		std::uint8_t right;
+		float constant;
+	};
+
+private:
+	HeightExpression(std::vector<Instruction> program, bool usesTime);
+
+	std::vector<Instruction> _program;
+
+	bool _usesTime;
+
+	using Block = std::array<float, LANES>;
+
+	class Parser;
+};
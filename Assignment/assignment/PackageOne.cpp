@@ -1,127 +1,148 @@
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <execution>
+#include <limits>
+#include <mutex>
 #include <numbers>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
 
 #include "PackageOne.h"
 #include "../drawable/Drawable.h"
 #include "../drawable/Color.h"
 
+// The cosines and sines of the angles splitting a full turn into equal segments,
+// computed once per segment count instead of once per vertex.
+struct UnitCircle {
+	std::vector<float> cos;
+	std::vector<float> sin;
+};
+
+static const UnitCircle& unitCircle(const int segments) {
+	// shared by every drawable and level of detail with the same segment count, which may be generating
+	// on several threads, and the nodes of the map stay put so the table outlives the lock
+	static auto mutex = std::mutex{};
+	static auto tables = std::unordered_map<int, UnitCircle>{};
+	const auto lock = std::scoped_lock{ mutex };
+	const auto [it, inserted] = tables.try_emplace(segments);
+	if (inserted) {
+		auto& [cosines, sines] = it->second;
+		cosines.resize(segments);
+		sines.resize(segments);
+		for (auto i = 0; i < segments; ++i) {
+			const auto angle = static_cast<float>(i) * 2.0f * std::numbers::pi_v<float> / static_cast<float>(segments);
+			cosines[i] = std::cos(angle);
+			sines[i] = std::sin(angle);
+		}
+	}
+	return it->second;
+}
+
+// Writes a position and a color, moving the output past the vertex.
+static void writeVertex(float*& output, const glm::vec3& position, const float* color) {
+	output[0] = position.x;
+	output[1] = position.y;
+	output[2] = position.z;
+	output[3] = color[0];
+	output[4] = color[1];
+	output[5] = color[2];
+	output += 6;
+}
+
+// The indices 0 to count - 1, for spreading rows over the cores with the parallel algorithms.
+static std::vector<int> rowIndices(const int count) {
+	auto rows = std::vector<int>(count);
+	std::iota(rows.begin(), rows.end(), 0);
+	return rows;
+}
+
+// The fixed primitives generate at compile time for constant arguments.
+static_assert(BakedTriangle::generate({ -0.5f, -0.5f, 0.0f }, { 0.5f, -0.5f, 0.0f }, { 0.0f, 0.5f, 0.0f }).vertices[6] == 0.5f);
+static_assert(BakedTetrahedron::generate({ -1.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.5f, 0.0f }, { -1.0f, 0.0f, 1.0f }).vertices[20] == 1.0f);
+static_assert(BakedCube::generate({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, 1.0f).vertices[2] == -0.5f);
+static_assert(BakedPyramid::generate({ 0.0f, 0.0f, -1.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, 1.0f, 2.0f).vertices[26] == 1.0f);
+
 std::vector<float> BakedTriangle::vertices() const {
-	return std::vector{
-		// position				// color
-		_p0.x, _p0.y, _p0.z,	srgb::RED[0],	srgb::RED[1],	srgb::RED[2],
-		_p1.x, _p1.y, _p1.z,	srgb::GREEN[0], srgb::GREEN[1], srgb::GREEN[2],
-		_p2.x, _p2.y, _p2.z,	srgb::BLUE[0],	srgb::BLUE[1],	srgb::BLUE[2],
-	};
+	return _geometry.toVertices();
 }
 
 std::vector<Primitive> BakedTriangle::primitives() const {
-	return std::vector{
-		Primitive{ GL_TRIANGLES, std::vector{ 0u, 1u, 2u } }
-	};
+	return _geometry.toPrimitives();
+}
+
+std::optional<DrawableSize> BakedTriangle::size() const {
+	return _geometry.size();
+}
+
+void BakedTriangle::write(VertexWriter& vertices, IndexWriter& indices) const {
+	_geometry.write(vertices, indices);
 }
 
 std::vector<float> BakedTetrahedron::vertices() const {
-	return std::vector{
-		// position				// color
-		_p0.x, _p0.y, _p0.z,	srgb::RED[0],	srgb::RED[1],	srgb::RED[2],
-		_p1.x, _p1.y, _p1.z,	srgb::GREEN[0], srgb::GREEN[1], srgb::GREEN[2],
-		_p2.x, _p2.y, _p2.z,	srgb::BLUE[0],	srgb::BLUE[1],	srgb::BLUE[2],
-		_p3.x, _p3.y, _p3.z,	srgb::CYAN[0],	srgb::CYAN[1],	srgb::CYAN[2],
-	};
+	return _geometry.toVertices();
 }
 
 std::vector<Primitive> BakedTetrahedron::primitives() const {
-	return std::vector{
-		Primitive{ GL_TRIANGLE_STRIP, std::vector{ 0u, 2u, 1u, 3u, 0u, 2u } }
-	};
+	return _geometry.toPrimitives();
 }
 
-std::vector<float> BakedCube::vertices() const {
-	const auto baseCenter = _center + -_upDir * _sideLength / 2.0f;
-	const auto baseRadius = _sideLength / static_cast<float>(std::sqrt(2));
-
-	const auto p0 = baseCenter + _corDir * baseRadius;
-	const auto p1 = baseCenter + normalize(cross(_upDir, _corDir)) * baseRadius;
-	const auto p2 = baseCenter + -_corDir * baseRadius;
-	const auto p3 = baseCenter + normalize(cross(_corDir, _upDir)) * baseRadius;
+std::optional<DrawableSize> BakedTetrahedron::size() const {
+	return _geometry.size();
+}
 
-	const auto p4 = p0 + _upDir * _sideLength;
-	const auto p5 = p1 + _upDir * _sideLength;
-	const auto p6 = p2 + _upDir * _sideLength;
-	const auto p7 = p3 + _upDir * _sideLength;
+void BakedTetrahedron::write(VertexWriter& vertices, IndexWriter& indices) const {
+	_geometry.write(vertices, indices);
+}
 
-	return std::vector{
-		// position			// color
-		p0.x, p0.y, p0.z,	srgb::RED[0],		srgb::RED[1],		srgb::RED[2],	
-		p1.x, p1.y, p1.z,	srgb::BLACK[0],		srgb::BLACK[1],		srgb::BLACK[2],
-		p2.x, p2.y, p2.z,	srgb::GREEN[0],		srgb::GREEN[1],		srgb::GREEN[2],
-		p3.x, p3.y, p3.z,	srgb::YELLOW[0],	srgb::YELLOW[1],	srgb::YELLOW[2],
-		p4.x, p4.y, p4.z,	srgb::MAGENTA[0],	srgb::MAGENTA[1],	srgb::MAGENTA[2],
-		p5.x, p5.y, p5.z,	srgb::BLUE[0],		srgb::BLUE[1],		srgb::BLUE[2],
-		p6.x, p6.y, p6.z,	srgb::CYAN[0],		srgb::CYAN[1],		srgb::CYAN[2],
-		p7.x, p7.y, p7.z,	srgb::WHITE[0],		srgb::WHITE[1],		srgb::WHITE[2],
-	};
+std::vector<float> BakedCube::vertices() const {
+	return _geometry.toVertices();
 }
 
 std::vector<Primitive> BakedCube::primitives() const {
-	return std::vector{
-		Primitive{GL_TRIANGLE_STRIP, std::vector{
-			4u, 0u, 5u, 1u, 6u, 2u, 7u, 3u, 4u, 0u,		// sides
-			// 0u, 4u,	// connection
-			// 4u, 5u, 7u, 6u,	// top
-			// 6u, 3u,	// connection
-			// 3u, 2u, 0u, 1u,	// bottom
-		}},
-		Primitive{GL_TRIANGLE_STRIP, std::vector{
-			4u, 5u, 7u, 6u,	// top
-		}},
-		Primitive{GL_TRIANGLE_STRIP, std::vector{
-			3u, 2u, 0u, 1u,	// bottom
-		}},
-	};
+	return _geometry.toPrimitives();
+}
+
+std::optional<DrawableSize> BakedCube::size() const {
+	return _geometry.size();
+}
+
+void BakedCube::write(VertexWriter& vertices, IndexWriter& indices) const {
+	_geometry.write(vertices, indices);
 }
 
 std::vector<float> BakedCone::vertices() const {
-	auto vertices = std::vector{
-		// base center
-		_center.x, _center.y, _center.z,
-		srgb::CYAN[0], srgb::CYAN[1], srgb::CYAN[2]
-	};
+	// base center, base circle and top
+	auto vertices = std::vector<float>((_segments + 2) * 6);
+	auto output = vertices.data();
+
+	writeVertex(output, _center, srgb::CYAN);
 
 	// Base circle
-	for (auto i = 0; i < SEGMENTS; ++i) {
-		const auto angle = static_cast<float>(i) * 2.0f * std::numbers::pi_v<float> / SEGMENTS;
-		const auto rot = glm::vec3{ std::cos(angle), std::sin(angle), 0.0f };
+	const auto& circle = unitCircle(_segments);
+	for (auto i = 0; i < _segments; ++i) {
+		const auto rot = glm::vec3{ circle.cos[i], circle.sin[i], 0.0f };
 		const auto dir = normalize(cross(_up, rot));
-		const auto point = _center + dir * _radius;
-		vertices.push_back(point.x);
-		vertices.push_back(point.y);
-		vertices.push_back(point.z);
-		vertices.push_back(srgb::PURPLE[0]);
-		vertices.push_back(srgb::PURPLE[1]);
-		vertices.push_back(srgb::PURPLE[2]);
+		writeVertex(output, _center + dir * _radius, srgb::PURPLE);
 	}
 
-	const auto top = _center + _up * _height;
-	vertices.push_back(top.x);
-	vertices.push_back(top.y);
-	vertices.push_back(top.z);
-	vertices.push_back(srgb::RED[0]);
-	vertices.push_back(srgb::RED[1]);
-	vertices.push_back(srgb::RED[2]);
+	writeVertex(output, _center + _up * _height, srgb::RED);
 
 	return vertices;
 }
 
 std::vector<Primitive> BakedCone::primitives() const {
 	auto circleIndices = std::vector{ 0u };
-	for (auto i = 0; i < SEGMENTS; ++i) {
+	for (auto i = 0; i < _segments; ++i) {
 		circleIndices.push_back(static_cast<IndexType>(i + 1));
 	}
 	circleIndices.push_back(1u);
 
-	auto coneIndices = std::vector{ static_cast<IndexType>(SEGMENTS + 1) };
-	for (auto i = 0; i < SEGMENTS; ++i) {
+	auto coneIndices = std::vector{ static_cast<IndexType>(_segments + 1) };
+	for (auto i = 0; i < _segments; ++i) {
 		coneIndices.push_back(static_cast<IndexType>(i + 1));
 	}
 	coneIndices.push_back(1u);
@@ -132,43 +153,32 @@ std::vector<Primitive> BakedCone::primitives() const {
 	};
 }
 
+std::vector<std::unique_ptr<Drawable>> BakedCone::coarserLevels() const {
+	auto levels = std::vector<std::unique_ptr<Drawable>>{};
+	for (auto segments = _segments / 2; segments >= MIN_SEGMENTS; segments /= 2) {
+		levels.push_back(std::make_unique<BakedCone>(_center, _radius, _height, _up, segments));
+	}
+	return levels;
+}
+
 std::vector<float> BakedStripSphere::vertices() const {
-	auto vertices = std::vector<float>{};
-
-	const auto top = _center + glm::vec3{ 0.0f, 0.0f, 1.0f } *_radius;
-	vertices.push_back(top.x);
-	vertices.push_back(top.y);
-	vertices.push_back(top.z);
-	vertices.push_back(srgb::YELLOW[0]);
-	vertices.push_back(srgb::YELLOW[1]);
-	vertices.push_back(srgb::YELLOW[2]);
-
-	const auto bot = _center + glm::vec3{ 0.0f, 0.0f, -1.0f } *_radius;
-	vertices.push_back(bot.x);
-	vertices.push_back(bot.y);
-	vertices.push_back(bot.z);
-	vertices.push_back(srgb::YELLOW[0]);
-	vertices.push_back(srgb::YELLOW[1]);
-	vertices.push_back(srgb::YELLOW[2]);
-
-	for (auto i = 1; i < DIVISIONS; ++i) {
-		const auto theta = static_cast<float>(i) * std::numbers::pi_v<float> / DIVISIONS;
-		for (auto j = 0; j < SEGMENTS; ++j) {
-			const auto phi = static_cast<float>(j) * 2.0f * std::numbers::pi_v<float> / SEGMENTS;
-
-			const auto diX = std::sin(theta) * std::cos(phi);
-			const auto diY = std::sin(theta) * std::sin(phi);
-			const auto diZ = std::cos(theta);
-
-			const auto dir = normalize(glm::vec3{ diX, diY, diZ });
-			const auto point = _center + dir * _radius;
-
-			vertices.push_back(point.x);
-			vertices.push_back(point.y);
-			vertices.push_back(point.z);
-			vertices.push_back(srgb::CYAN[0]);
-			vertices.push_back(srgb::CYAN[1]);
-			vertices.push_back(srgb::CYAN[2]);
+	// the poles, then every ring between them
+	auto vertices = std::vector<float>((2 + (_divisions - 1) * _segments) * 6);
+	auto output = vertices.data();
+
+	writeVertex(output, _center + glm::vec3{ 0.0f, 0.0f, 1.0f } * _radius, srgb::YELLOW);
+	writeVertex(output, _center + glm::vec3{ 0.0f, 0.0f, -1.0f } * _radius, srgb::YELLOW);
+
+	// theta only spans half a turn, which is every other angle of a circle with twice the divisions
+	const auto& meridian = unitCircle(2 * _divisions);
+	const auto& parallel = unitCircle(_segments);
+	for (auto i = 1; i < _divisions; ++i) {
+		const auto sinTheta = meridian.sin[i];
+		const auto cosTheta = meridian.cos[i];
+		for (auto j = 0; j < _segments; ++j) {
+			// already of unit length
+			const auto dir = glm::vec3{ sinTheta * parallel.cos[j], sinTheta * parallel.sin[j], cosTheta };
+			writeVertex(output, _center + dir * _radius, srgb::CYAN);
 		}
 	}
 
@@ -178,66 +188,66 @@ std::vector<float> BakedStripSphere::vertices() const {
 std::vector<Primitive> BakedStripSphere::primitives() const {
 	auto primitives = std::vector<Primitive>{};
 
-	for (auto i = 0; i < DIVISIONS - 2; ++i) {
+	for (auto i = 0; i < _divisions - 2; ++i) {
 		auto indices = std::vector<IndexType>{};
-		for (auto j = 0; j < SEGMENTS; ++j) {
-			indices.push_back(i * SEGMENTS + j + 2);
-			indices.push_back((i + 1) * SEGMENTS + j + 2);
+		for (auto j = 0; j < _segments; ++j) {
+			indices.push_back(i * _segments + j + 2);
+			indices.push_back((i + 1) * _segments + j + 2);
 		}
-		indices.push_back(i * SEGMENTS + 2);
-		indices.push_back((i + 1) * SEGMENTS + 2);
+		indices.push_back(i * _segments + 2);
+		indices.push_back((i + 1) * _segments + 2);
 
 		primitives.emplace_back(GL_TRIANGLE_STRIP, indices);
 	}
 
 	auto topIndices = std::vector{ 0u };
-	for (auto i = 0; i < SEGMENTS; ++i) {
+	for (auto i = 0; i < _segments; ++i) {
 		topIndices.push_back(i + 2);
 	}
 	topIndices.push_back(2u);
 	primitives.emplace_back(GL_TRIANGLE_FAN, topIndices);
 
 	auto botIndices = std::vector{ 1u };
-	constexpr auto lastDiv = DIVISIONS - 2;
-	for (auto i = 0; i < SEGMENTS; ++i) {
-		botIndices.push_back(lastDiv * SEGMENTS + i + 2);
+	const auto lastDiv = _divisions - 2;
+	for (auto i = 0; i < _segments; ++i) {
+		botIndices.push_back(lastDiv * _segments + i + 2);
 	}
-	botIndices.push_back(lastDiv * SEGMENTS + 2);
+	botIndices.push_back(lastDiv * _segments + 2);
 	primitives.emplace_back(GL_TRIANGLE_FAN, botIndices);
 
 	return primitives;
 }
 
+std::vector<std::unique_ptr<Drawable>> BakedStripSphere::coarserLevels() const {
+	auto levels = std::vector<std::unique_ptr<Drawable>>{};
+	auto segments = _segments / 2;
+	auto divisions = _divisions / 2;
+	for (; segments >= MIN_SEGMENTS && divisions >= MIN_DIVISIONS; segments /= 2, divisions /= 2) {
+		levels.push_back(std::make_unique<BakedStripSphere>(_center, _radius, segments, divisions));
+	}
+	return levels;
+}
+
 std::vector<float> BakedCylinder::vertices() const {
-	auto vertices = std::vector<float>{};
+	// a center and a circle for each base
+	auto vertices = std::vector<float>(2 * (_segments + 1) * 6);
+	auto output = vertices.data();
 
+	const auto& circle = unitCircle(_segments);
 	for (auto i = 0; i < 2; ++i) {
 		// the actual center
 		const auto center = _center + _up * (_height * static_cast<float>(i));
 
 		// center vertex
-		vertices.push_back(center.x);
-		vertices.push_back(center.y);
-		vertices.push_back(center.z);
-		vertices.push_back(srgb::BLUE[0]);
-		vertices.push_back(srgb::BLUE[1]);
-		vertices.push_back(srgb::BLUE[2]);
+		writeVertex(output, center, srgb::BLUE);
 		// circular vertices
-		for (auto j = 0; j < SEGMENTS; ++j) {
-			// the angle of rotation
-			const auto angle = static_cast<float>(j) * 2.0f * std::numbers::pi_v<float> / SEGMENTS;
+		for (auto j = 0; j < _segments; ++j) {
 			// rotation vector on the XY-plane
-			const auto rot = glm::vec3{ std::cos(angle), std::sin(angle), 0.0f };
+			const auto rot = glm::vec3{ circle.cos[j], circle.sin[j], 0.0f };
 			// the direction to the point on circle
 			const auto dir = normalize(cross(_up, rot));
 			// translate to that point
-			const auto point = center + dir * _radius;
-			vertices.push_back(point.x);
-			vertices.push_back(point.y);
-			vertices.push_back(point.z);
-			vertices.push_back(srgb::CYAN[0]);
-			vertices.push_back(srgb::CYAN[1]);
-			vertices.push_back(srgb::CYAN[2]);
+			writeVertex(output, center + dir * _radius, srgb::CYAN);
 		}
 	}
 
@@ -249,104 +259,419 @@ std::vector<Primitive> BakedCylinder::primitives() const {
 
 	// the top and the bot triangle fans
 	for (auto i = 0; i < 2; ++i) {
-		auto baseIndices = std::vector{ static_cast<IndexType>(i * (SEGMENTS + 1)) };
-		for (auto j = 0; j < SEGMENTS; ++j) {
-			baseIndices.push_back(static_cast<IndexType>(j + 1 + i * (SEGMENTS + 1)));
+		auto baseIndices = std::vector{ static_cast<IndexType>(i * (_segments + 1)) };
+		for (auto j = 0; j < _segments; ++j) {
+			baseIndices.push_back(static_cast<IndexType>(j + 1 + i * (_segments + 1)));
 		}
-		baseIndices.push_back(1u + static_cast<IndexType>(i * (SEGMENTS + 1)));
+		baseIndices.push_back(1u + static_cast<IndexType>(i * (_segments + 1)));
 
 		primitives.emplace_back(GL_TRIANGLE_FAN, baseIndices);
 	}
 
 	// the side triangle strip
 	auto sideIndices = std::vector<IndexType>{};
-	for (auto i = 0; i < SEGMENTS; ++i) {
-		sideIndices.push_back(static_cast<IndexType>(i + 2 + SEGMENTS));
+	for (auto i = 0; i < _segments; ++i) {
+		sideIndices.push_back(static_cast<IndexType>(i + 2 + _segments));
 		sideIndices.push_back(static_cast<IndexType>(i + 1));
 	}
-	sideIndices.push_back(static_cast<IndexType>(2 + SEGMENTS));
+	sideIndices.push_back(static_cast<IndexType>(2 + _segments));
 	sideIndices.push_back(1u);
 	primitives.emplace_back(GL_TRIANGLE_STRIP, sideIndices);
 
 	return primitives;
 }
 
-std::vector<float> BakedPyramid::vertices() const {
-	const auto baseRadius = _baseLength / static_cast<float>(std::sqrt(2));
+std::vector<std::unique_ptr<Drawable>> BakedCylinder::coarserLevels() const {
+	auto levels = std::vector<std::unique_ptr<Drawable>>{};
+	for (auto segments = _segments / 2; segments >= MIN_SEGMENTS; segments /= 2) {
+		levels.push_back(std::make_unique<BakedCylinder>(_center, _radius, _height, _up, segments));
+	}
+	return levels;
+}
 
-	// base square
-	const auto p0 = _baseCenter + _side * baseRadius;
-	const auto p1 = _baseCenter + normalize(cross(_up, _side)) * baseRadius;
-	const auto p2 = _baseCenter + -_side * baseRadius;
-	const auto p3 = _baseCenter + normalize(cross(_side, _up)) * baseRadius;
+std::vector<float> BakedPyramid::vertices() const {
+	return _geometry.toVertices();
+}
 
-	// top
-	const auto p4 = _baseCenter + _up * _height;
+std::vector<Primitive> BakedPyramid::primitives() const {
+	return _geometry.toPrimitives();
+}
 
-	return std::vector{
-		// position			// color
-		p0.x, p0.y, p0.z,	srgb::RED[0],		srgb::RED[1],		srgb::RED[2],
-		p1.x, p1.y, p1.z,	srgb::BLUE[0],		srgb::BLUE[1],		srgb::BLUE[2],
-		p2.x, p2.y, p2.z,	srgb::GREEN[0],		srgb::GREEN[1],		srgb::GREEN[2],
-		p3.x, p3.y, p3.z,	srgb::YELLOW[0],	srgb::YELLOW[1],	srgb::YELLOW[2],
-		p4.x, p4.y, p4.z,	srgb::MAGENTA[0],	srgb::MAGENTA[1],	srgb::MAGENTA[2],
-	};
+std::optional<DrawableSize> BakedPyramid::size() const {
+	return _geometry.size();
 }
 
-std::vector<Primitive> BakedPyramid::primitives() const {
-	return std::vector{
-		Primitive{ GL_TRIANGLE_STRIP, std::vector{ 0u, 3u, 1u, 2u } },
-		Primitive{ GL_TRIANGLE_FAN, std::vector{ 4u, 0u, 1u, 2u, 3u, 0u }  }
-	};
+void BakedPyramid::write(VertexWriter& vertices, IndexWriter& indices) const {
+	_geometry.write(vertices, indices);
 }
 
+BakedMesh::BakedMesh(
+	HeightBatch func,
+	const bool animated,
+	const float halfExtentX,
+	const float halfExtentY,
+	const int segmentsX,
+	const int segmentsY
+) : _func{ std::move(func) }, _animated{ animated }, _halfExtentX{ halfExtentX }, _halfExtentY{ halfExtentY },
+_segmentsX{ segmentsX }, _segmentsY{ segmentsY }, _ys{ columnCoordinates(halfExtentY, segmentsY) },
+_rows{ rowIndices(segmentsX + 1) }, _stride{ vertexStride(layout()) } {}
+
 std::vector<float> BakedMesh::vertices() const {
-	auto vertices = std::vector<float>{};
+	constexpr auto components = std::size_t{ 6 };
+	const auto rowVertices = static_cast<std::size_t>(_segmentsY + 1);
+
+	// sized up front, so every row writes its own slice and no thread ever reallocates
+	auto vertices = std::vector<float>(static_cast<std::size_t>(_segmentsX + 1) * rowVertices * components);
 
 	const auto xStep = _halfExtentX * 2 / static_cast<float>(_segmentsX);
-	const auto yStep = _halfExtentY * 2 / static_cast<float>(_segmentsY);
-
-	for (auto i = 0; i < _segmentsX + 1; ++i) {
-		for (auto j = 0; j < _segmentsY + 1; ++j) {
-			// acquire the x, y coordinate
-			const auto x = static_cast<float>(i) * xStep - _halfExtentX;	// from top left
-			const auto y = _halfExtentY - static_cast<float>(j) * yStep;	// to bottom right
-			// evaluate z
-			const auto z = _func(x, y);
-			vertices.push_back(x);
-			vertices.push_back(y);
-			vertices.push_back(z);
-			vertices.push_back(srgb::YELLOW[0]);
-			vertices.push_back(srgb::YELLOW[1]);
-			vertices.push_back(srgb::YELLOW[2]);
+	const auto& ys = _ys;
+
+	std::for_each(std::execution::par, _rows.begin(), _rows.end(), [&](const auto i) {
+		// acquire the x coordinate, from top left to bottom right
+		const auto x = static_cast<float>(i) * xStep - _halfExtentX;
+		const auto row = vertices.data() + static_cast<std::size_t>(i) * rowVertices * components;
+
+		// branchless strided stores, which the compiler turns into vector code
+		for (std::size_t j = 0; j < rowVertices; ++j) {
+			const auto vertex = row + j * components;
+			vertex[0] = x;
+			vertex[1] = ys[j];
+			vertex[3] = srgb::YELLOW[0];
+			vertex[4] = srgb::YELLOW[1];
+			vertex[5] = srgb::YELLOW[2];
 		}
-	}
+
+		// evaluate z at the start of time, the whole row in a single batch
+		auto zs = std::vector<float>(rowVertices);
+		evaluateRow(x, ys, 0.0f, zs);
+		for (std::size_t j = 0; j < rowVertices; ++j) {
+			row[j * components + 2] = zs[j];
+		}
+	});
 
 	return vertices;
 }
 
+std::vector<GenericAttribute> BakedMesh::layout() const {
+	return std::vector{
+		GenericAttribute{ AttributeSize::VEC_3, true },								// position
+		GenericAttribute{ AttributeSize::VEC_3, true, AttributeType::UNSIGNED_BYTE }	// color
+	};
+}
+
 std::vector<Primitive> BakedMesh::primitives() const {
 	auto primitives = std::vector<Primitive>{};
+	primitives.reserve(_segmentsY);
 
-	// for each x-wide strip starting at the most y 
+	// for each x-wide strip starting at the most y,
+	// the engine stitches them together when the mesh gets loaded
 	for (auto i = 0; i < _segmentsY; ++i) {
-		// connection to the previous strip
-		// if (i > 0) {
-		//	   indices.push_back(i * (_segmentsX + 1));
-		// }
-		auto indices = std::vector<IndexType>{};
+		auto indices = std::vector<IndexType>(2 * static_cast<std::size_t>(_segmentsX + 1));
 		// for each column pair of vertices starting at the least x
 		for (auto j = 0; j < _segmentsX + 1; ++j) {
-			indices.push_back(j + i * (_segmentsX + 1));
-			indices.push_back(j + (i + 1) * (_segmentsX + 1));
+			indices[2 * j] = j + i * (_segmentsX + 1);
+			indices[2 * j + 1] = j + (i + 1) * (_segmentsX + 1);
 		}
-		// connection to the next strip
-		// if (i < _segmentsY) {
-		//	   indices.push_back(_segmentsX + (i + 1) * (_segmentsX + 1));
-		// }
-		primitives.emplace_back(GL_TRIANGLE_STRIP, indices);
+		primitives.emplace_back(GL_TRIANGLE_STRIP, std::move(indices));
 	}
 	return primitives;
 }
 
+std::optional<DrawableSize> BakedMesh::size() const {
+	const auto stripIndices = 2 * static_cast<std::size_t>(_segmentsX + 1);
+	return DrawableSize{
+		static_cast<std::size_t>(_segmentsX + 1) * static_cast<std::size_t>(_segmentsY + 1),
+		std::vector(static_cast<std::size_t>(_segmentsY), PrimitiveSize{ GL_TRIANGLE_STRIP, stripIndices })
+	};
+}
+
+void BakedMesh::write(VertexWriter& vertices, IndexWriter& indices) const {
+	const auto xStep = _halfExtentX * 2 / static_cast<float>(_segmentsX);
+	const auto& ys = _ys;
+	const auto rowVertices = ys.size();
+
+	// in the same order as vertices, every row packing itself straight into its own slice of the upload memory
+	auto lowest = std::vector<float>(static_cast<std::size_t>(_segmentsX + 1));
+	auto highest = std::vector<float>(lowest.size());
+	std::for_each(std::execution::par, _rows.begin(), _rows.end(), [&](const auto i) {
+		const auto x = static_cast<float>(i) * xStep - _halfExtentX;
+		auto zs = std::vector<float>(rowVertices);
+		evaluateRow(x, ys, 0.0f, zs);
+
+		const auto first = static_cast<std::size_t>(i) * rowVertices;
+		for (std::size_t j = 0; j < rowVertices; ++j) {
+			vertices.writeAt(first + j, std::array{ x, ys[j], zs[j], srgb::YELLOW[0], srgb::YELLOW[1], srgb::YELLOW[2] });
+		}
+		const auto [low, high] = std::ranges::minmax(zs);
+		lowest[i] = low;
+		highest[i] = high;
+	});
+	vertices.commit(
+		lowest.size() * rowVertices,
+		{ -_halfExtentX, std::min(ys.front(), ys.back()), std::ranges::min(lowest) },
+		{ static_cast<float>(_segmentsX) * xStep - _halfExtentX, std::max(ys.front(), ys.back()), std::ranges::max(highest) }
+	);
+
+	// in the same order as primitives
+	for (auto i = 0; i < _segmentsY; ++i) {
+		for (auto j = 0; j < _segmentsX + 1; ++j) {
+			indices.write(j + i * (_segmentsX + 1));
+			indices.write(j + (i + 1) * (_segmentsX + 1));
+		}
+	}
+}
+
+bool BakedMesh::isAnimated() const {
+	return _animated;
+}
+
+MeshBounds BakedMesh::animate(const float time, const std::span<std::byte> vertices) const {
+	// positions are full floats at the start of each vertex, see layout
+	const auto rowVertices = _ys.size();
+	if (vertices.size() < _rows.size() * rowVertices * _stride) {
+		throw std::exception{ "The vertices are too few for the mesh\n" };
+	}
+
+	const auto xStep = _halfExtentX * 2 / static_cast<float>(_segmentsX);
+
+	// every row of constant x is independent, so they get spread over all cores, each reporting
+	// the range of its heights for the bounds
+	using Range = std::pair<float, float>;
+	const auto [lowest, highest] = std::transform_reduce(
+		std::execution::par, _rows.begin(), _rows.end(),
+		Range{ std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() },
+		[](const Range& a, const Range& b) {
+			return Range{ std::min(a.first, b.first), std::max(a.second, b.second) };
+		},
+		[&](const auto i) {
+			const auto x = static_cast<float>(i) * xStep - _halfExtentX;
+
+			// the worker threads outlive the frame, so their scratch rows stop allocating after the first one
+			thread_local auto zs = std::vector<float>{};
+			zs.resize(rowVertices);
+			evaluateRow(x, _ys, time, zs);
+
+			auto destination = vertices.data() + static_cast<std::size_t>(i) * rowVertices * _stride + 2 * sizeof(float);
+			for (std::size_t j = 0; j < rowVertices; ++j) {
+				std::memcpy(destination, &zs[j], sizeof(float));
+				destination += _stride;
+			}
+			const auto [low, high] = std::ranges::minmax(zs);
+			return Range{ low, high };
+		}
+	);
+
+	const auto min = glm::vec3{ -_halfExtentX, std::min(_ys.front(), _ys.back()), lowest };
+	const auto max = glm::vec3{
+		static_cast<float>(_segmentsX) * xStep - _halfExtentX, std::max(_ys.front(), _ys.back()), highest
+	};
+	return MeshBounds{ (min + max) * 0.5f, glm::length(max - min) * 0.5f, min, max };
+}
+
+void BakedMesh::evaluateRow(
+	const float x,
+	const std::span<const float> ys,
+	const float time,
+	const std::span<float> zs
+) const {
+	thread_local auto xs = std::vector<float>{};
+	xs.assign(zs.size(), x);
+	_func(xs, ys, time, zs);
+}
+
+std::vector<float> BakedMesh::columnCoordinates(const float halfExtentY, const int segmentsY) {
+	// y only depends on the column, so every row shares the same table
+	const auto yStep = halfExtentY * 2 / static_cast<float>(segmentsY);
+	auto ys = std::vector<float>(static_cast<std::size_t>(segmentsY + 1));
+	for (std::size_t j = 0; j < ys.size(); ++j) {
+		ys[j] = halfExtentY - static_cast<float>(j) * yStep;
+	}
+	return ys;
+}
+
+AdaptiveMesh BakedMesh::Builder::buildAdaptive(const float tolerance) const {
+	return AdaptiveMesh(_func, _halfExtentX, _halfExtentY, std::max(_segmentsX, _segmentsY), tolerance);
+}
+
+// The right triangles of the network, walked from the two halves of the lattice down.
+// A triangle is given by its corners on the lattice, c being the right angle, so ab is the longest edge
+// and its midpoint is where the triangle splits.
+struct RightTriangulation {
+	const std::vector<float>& heights;
+	const std::vector<float>& errors;
+	const int gridSize;
+	const float tolerance;
+	std::vector<int>& corners;
+
+	void refine(const int ax, const int ay, const int bx, const int by, const int cx, const int cy) const {
+		const auto mx = (ax + bx) / 2;
+		const auto my = (ay + by) / 2;
+		if (std::abs(ax - cx) + std::abs(ay - cy) > 1 && errors[mx * gridSize + my] > tolerance) {
+			refine(cx, cy, ax, ay, mx, my);
+			refine(bx, by, cx, cy, mx, my);
+		} else {
+			corners.insert(corners.end(), { ax * gridSize + ay, bx * gridSize + by, cx * gridSize + cy });
+		}
+	}
+};
+
+AdaptiveMesh::AdaptiveMesh(
+	const BakedMesh::HeightBatch& func,
+	const float halfExtentX,
+	const float halfExtentY,
+	const int segments,
+	const float tolerance
+) {
+	if (tolerance < 0.0f) {
+		throw std::exception{ "The tolerance must not be negative\n" };
+	}
 
+	// the network needs a power of two of cells along each side
+	auto tiles = 1;
+	while (tiles < segments) {
+		tiles *= 2;
+	}
+	const auto gridSize = tiles + 1;
+	const auto xStep = halfExtentX * 2 / static_cast<float>(tiles);
+	const auto yStep = halfExtentY * 2 / static_cast<float>(tiles);
+	_latticeTriangles = 2 * static_cast<std::size_t>(tiles) * static_cast<std::size_t>(tiles);
+
+	// sample the whole lattice, in the same order as BakedMesh
+	auto ys = std::vector<float>(gridSize);
+	for (auto j = 0; j < gridSize; ++j) {
+		ys[j] = halfExtentY - static_cast<float>(j) * yStep;
+	}
+	auto heights = std::vector<float>(static_cast<std::size_t>(gridSize) * gridSize);
+	const auto rows = rowIndices(gridSize);
+	std::for_each(std::execution::par, rows.begin(), rows.end(), [&](const auto i) {
+		const auto xs = std::vector(ys.size(), static_cast<float>(i) * xStep - halfExtentX);
+		func(xs, ys, 0.0f, std::span{ heights }.subspan(static_cast<std::size_t>(i) * gridSize, gridSize));
+	});
+
+	// How far the lattice points a triangle covers lie from its plane at worst, its midpoint included.
+	// The legs from the right angle are perpendicular and of equal length, so they make a cheap frame.
+	const auto planeError = [&](const int ax, const int ay, const int bx, const int by, const int cx, const int cy) {
+		const auto legLength = (ax - cx) * (ax - cx) + (ay - cy) * (ay - cy);
+		const auto hc = heights[cx * gridSize + cy];
+		const auto dha = heights[ax * gridSize + ay] - hc;
+		const auto dhb = heights[bx * gridSize + by] - hc;
+		auto error = 0.0f;
+		for (auto x = std::min({ ax, bx, cx }); x <= std::max({ ax, bx, cx }); ++x) {
+			for (auto y = std::min({ ay, by, cy }); y <= std::max({ ay, by, cy }); ++y) {
+				const auto u = (x - cx) * (ax - cx) + (y - cy) * (ay - cy);
+				const auto v = (x - cx) * (bx - cx) + (y - cy) * (by - cy);
+				if (u < 0 || v < 0 || u + v > legLength) {
+					continue;
+				}
+				const auto interpolated = hc + (dha * static_cast<float>(u) + dhb * static_cast<float>(v)) / static_cast<float>(legLength);
+				error = std::max(error, std::abs(interpolated - heights[x * gridSize + y]));
+			}
+		}
+		return error;
+	};
+
+	// The error of keeping a triangle is how far the surface strays from it anywhere it covers, or the error
+	// of any triangle below it, whichever is worst. Going from the smallest triangles up, every midpoint gathers
+	// the errors of the triangles it is shared by, so the two triangles on either side of an edge always split
+	// together, and no triangle is kept while the surface strays from it by more than the tolerance.
+	auto errors = std::vector<float>(heights.size());
+	const auto smallestTriangles = static_cast<std::int64_t>(tiles) * tiles;
+	const auto triangles = smallestTriangles * 2 - 2;
+	for (auto t = triangles - 1; t >= 0; --t) {
+		// the bits of the id trace the path from the two halves of the lattice down to the triangle
+		auto id = t + 2;
+		auto ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+		if (id & 1) {
+			bx = by = cx = tiles;
+		} else {
+			ax = ay = cy = tiles;
+		}
+		while ((id >>= 1) > 1) {
+			const auto mx = (ax + bx) / 2;
+			const auto my = (ay + by) / 2;
+			if (id & 1) {
+				bx = ax;
+				by = ay;
+				ax = cx;
+				ay = cy;
+			} else {
+				ax = bx;
+				ay = by;
+				bx = cx;
+				by = cy;
+			}
+			cx = mx;
+			cy = my;
+		}
+
+		const auto mx = (ax + bx) / 2;
+		const auto my = (ay + by) / 2;
+		const auto middle = mx * gridSize + my;
+		auto error = std::max(errors[middle], planeError(ax, ay, bx, by, cx, cy));
+		if (t < triangles - smallestTriangles) {
+			error = std::max({
+				error,
+				errors[(ax + cx) / 2 * gridSize + (ay + cy) / 2],
+				errors[(bx + cx) / 2 * gridSize + (by + cy) / 2]
+			});
+		}
+		errors[middle] = error;
+	}
+
+	auto corners = std::vector<int>{};
+	const auto network = RightTriangulation{ heights, errors, gridSize, tolerance, corners };
+	network.refine(0, 0, tiles, tiles, tiles, 0);
+	network.refine(tiles, tiles, 0, 0, 0, tiles);
+
+	// only the lattice points some triangle uses become vertices, numbered in the order they are first used
+	auto vertexOf = std::vector<int>(heights.size(), -1);
+	_indices.reserve(corners.size());
+	for (const auto corner : corners) {
+		if (vertexOf[corner] < 0) {
+			vertexOf[corner] = static_cast<int>(_vertices.size() / 6);
+			const auto i = corner / gridSize;
+			const auto j = corner % gridSize;
+			_vertices.insert(_vertices.end(), {
+				static_cast<float>(i) * xStep - halfExtentX, ys[j], heights[corner],
+				srgb::YELLOW[0], srgb::YELLOW[1], srgb::YELLOW[2]
+			});
+		}
+		_indices.push_back(static_cast<IndexType>(vertexOf[corner]));
+	}
+}
+
+std::vector<float> AdaptiveMesh::vertices() const {
+	return _vertices;
+}
+
+std::vector<GenericAttribute> AdaptiveMesh::layout() const {
+	return std::vector{
+		GenericAttribute{ AttributeSize::VEC_3, true },								// position
+		GenericAttribute{ AttributeSize::VEC_3, true, AttributeType::UNSIGNED_BYTE }	// color
+	};
+}
+
+std::vector<Primitive> AdaptiveMesh::primitives() const {
+	return std::vector{ Primitive{ GL_TRIANGLES, _indices } };
+}
+
+std::optional<DrawableSize> AdaptiveMesh::size() const {
+	return DrawableSize{ _vertices.size() / 6, std::vector{ PrimitiveSize{ GL_TRIANGLES, _indices.size() } } };
+}
+
+void AdaptiveMesh::write(VertexWriter& vertices, IndexWriter& indices) const {
+	for (std::size_t v = 0; v < _vertices.size(); v += 6) {
+		vertices.write(std::span{ _vertices }.subspan(v, 6));
+	}
+	for (const auto index : _indices) {
+		indices.write(index);
+	}
+}
+
+std::size_t AdaptiveMesh::getTriangleCount() const {
+	return _indices.size() / 3;
+}
+
+std::size_t AdaptiveMesh::getLatticeTriangleCount() const {
+	return _latticeTriangles;
+}
@@ -1,12 +1,29 @@
 #pragma once
 
+#include <concepts>
+#include <cstddef>
 #include <functional>
+#include <memory>
+#include <numbers>
+#include <optional>
+#include <span>
+#include <type_traits>
 #include <utility>
 
 #include <glm/glm.hpp>
 
+#include "HeightExpression.h"
+#include "../Mesh.h"
+#include "../drawable/Color.h"
 #include "../drawable/Drawable.h"
+#include "../drawable/FixedGeometry.h"
 
+class AdaptiveMesh;
+class Terrain;
+
+
+// The coarsest circle the level-of-detail chains of round shapes go down to.
+inline constexpr auto MIN_SEGMENTS = 8;
 
 class BakedTriangle final : public BakedColorDrawable {
 public:
@@ -14,18 +31,28 @@ public:
 		const glm::vec3& p0 = glm::vec3{ -0.5f, -0.5f, 0.0f },
 		const glm::vec3& p1 = glm::vec3{ 0.5f, -0.5f, 0.0f },
 		const glm::vec3& p2 = glm::vec3{ 0.0f,  0.5f, 0.0f }
-	) : _p0{ p0 }, _p1{ p1 }, _p2{ p2 } {}
+	) : _geometry{ generate({ p0.x, p0.y, p0.z }, { p1.x, p1.y, p1.z }, { p2.x, p2.y, p2.z }) } {}
 
 	[[nodiscard]] std::vector<float> vertices() const override;
 
 	[[nodiscard]] std::vector<Primitive> primitives() const override;
 
-private:
-	const glm::vec3 _p0;
+	[[nodiscard]] std::optional<DrawableSize> size() const override;
 
-	const glm::vec3 _p1;
+	void write(VertexWriter& vertices, IndexWriter& indices) const override;
 
-	const glm::vec3 _p2;
+	using Geometry = FixedGeometry<3, 3, 1>;
+
+	static constexpr Geometry generate(const fixed::Point& p0, const fixed::Point& p1, const fixed::Point& p2) {
+		auto geometry = Geometry{ {}, { 0u, 1u, 2u }, { FixedPrimitive{ GL_TRIANGLES, 0, 3 } } };
+		fixed::vertex(geometry.vertices, 0, p0, srgb::RED);
+		fixed::vertex(geometry.vertices, 1, p1, srgb::GREEN);
+		fixed::vertex(geometry.vertices, 2, p2, srgb::BLUE);
+		return geometry;
+	}
+
+private:
+	const Geometry _geometry;
 };
 
 class BakedTetrahedron final : public BakedColorDrawable {
@@ -35,20 +62,31 @@ public:
 		const glm::vec3& p1 = glm::vec3{  0.0f, -1.0f, 0.0f }, 
 		const glm::vec3& p2 = glm::vec3{  0.0f,  0.5f, 0.0f },
 		const glm::vec3& p3 = glm::vec3{ -1.0f,  0.0f, 1.0f }
-	) : _p0{ p0 }, _p1{ p1 }, _p2{ p2 }, _p3{ p3 } {}
+	) : _geometry{ generate({ p0.x, p0.y, p0.z }, { p1.x, p1.y, p1.z }, { p2.x, p2.y, p2.z }, { p3.x, p3.y, p3.z }) } {}
 
 	[[nodiscard]] std::vector<float> vertices() const override;
 
 	[[nodiscard]] std::vector<Primitive> primitives() const override;
 
-private:
-	const glm::vec3 _p0;
+	[[nodiscard]] std::optional<DrawableSize> size() const override;
 
-	const glm::vec3 _p1;
+	void write(VertexWriter& vertices, IndexWriter& indices) const override;
 
-	const glm::vec3 _p2;
+	using Geometry = FixedGeometry<4, 6, 1>;
 
-	const glm::vec3 _p3;
+	static constexpr Geometry generate(
+		const fixed::Point& p0, const fixed::Point& p1, const fixed::Point& p2, const fixed::Point& p3
+	) {
+		auto geometry = Geometry{ {}, { 0u, 2u, 1u, 3u, 0u, 2u }, { FixedPrimitive{ GL_TRIANGLE_STRIP, 0, 6 } } };
+		fixed::vertex(geometry.vertices, 0, p0, srgb::RED);
+		fixed::vertex(geometry.vertices, 1, p1, srgb::GREEN);
+		fixed::vertex(geometry.vertices, 2, p2, srgb::BLUE);
+		fixed::vertex(geometry.vertices, 3, p3, srgb::CYAN);
+		return geometry;
+	}
+
+private:
+	const Geometry _geometry;
 };
 
 class BakedCube final : public BakedColorDrawable {
@@ -58,7 +96,7 @@ public:
 		const glm::vec3& upDir  = glm::vec3{ 0.0f,  0.0f,  1.0f },
 		const glm::vec3& corDir = glm::vec3{ 1.0f,  0.0f,  0.0f },
 		const float sideLength  = 1.0f
-	) : _center{ center }, _upDir{ normalize(upDir) }, _corDir{ normalize(corDir) }, _sideLength{ sideLength } {
+	) : _geometry{ generate({ center.x, center.y, center.z }, { upDir.x, upDir.y, upDir.z }, { corDir.x, corDir.y, corDir.z }, sideLength) } {
 		if (dot(upDir, corDir) != 0.0f) {
 			throw std::exception{ "The up and corner directions of the cube are not perpendicular\n" };
 		}
@@ -72,14 +110,52 @@ public:
 
 	[[nodiscard]] std::vector<Primitive> primitives() const override;
 
-private:
-	const glm::vec3 _center;
-
-	const glm::vec3 _upDir;
-
-	const glm::vec3 _corDir;
+	[[nodiscard]] std::optional<DrawableSize> size() const override;
+
+	void write(VertexWriter& vertices, IndexWriter& indices) const override;
+
+	using Geometry = FixedGeometry<8, 18, 3>;
+
+	static constexpr Geometry generate(
+		const fixed::Point& center, const fixed::Point& upDir, const fixed::Point& corDir, const float sideLength
+	) {
+		const auto up = fixed::normalize(upDir);
+		const auto cor = fixed::normalize(corDir);
+		const auto baseCenter = fixed::add(center, fixed::scale(up, -sideLength / 2.0f));
+		const auto baseRadius = sideLength / std::numbers::sqrt2_v<float>;
+
+		const auto p0 = fixed::add(baseCenter, fixed::scale(cor, baseRadius));
+		const auto p1 = fixed::add(baseCenter, fixed::scale(fixed::normalize(fixed::cross(up, cor)), baseRadius));
+		const auto p2 = fixed::add(baseCenter, fixed::scale(cor, -baseRadius));
+		const auto p3 = fixed::add(baseCenter, fixed::scale(fixed::normalize(fixed::cross(cor, up)), baseRadius));
+		const auto top = fixed::scale(up, sideLength);
+
+		auto geometry = Geometry{
+			{},
+			{
+				4u, 0u, 5u, 1u, 6u, 2u, 7u, 3u, 4u, 0u,	// sides
+				4u, 5u, 7u, 6u,							// top
+				3u, 2u, 0u, 1u,							// bottom
+			},
+			{
+				FixedPrimitive{ GL_TRIANGLE_STRIP, 0, 10 },
+				FixedPrimitive{ GL_TRIANGLE_STRIP, 10, 4 },
+				FixedPrimitive{ GL_TRIANGLE_STRIP, 14, 4 },
+			}
+		};
+		fixed::vertex(geometry.vertices, 0, p0, srgb::RED);
+		fixed::vertex(geometry.vertices, 1, p1, srgb::BLACK);
+		fixed::vertex(geometry.vertices, 2, p2, srgb::GREEN);
+		fixed::vertex(geometry.vertices, 3, p3, srgb::YELLOW);
+		fixed::vertex(geometry.vertices, 4, fixed::add(p0, top), srgb::MAGENTA);
+		fixed::vertex(geometry.vertices, 5, fixed::add(p1, top), srgb::BLUE);
+		fixed::vertex(geometry.vertices, 6, fixed::add(p2, top), srgb::CYAN);
+		fixed::vertex(geometry.vertices, 7, fixed::add(p3, top), srgb::WHITE);
+		return geometry;
+	}
 
-	const float _sideLength;
+private:
+	const Geometry _geometry;
 };
 
 class BakedCone final : public BakedColorDrawable {
@@ -88,8 +164,9 @@ public:
 		const glm::vec3& center = glm::vec3{ 0.0f,  0.0f, -1.0f },
 		const float radius = 1.0f,
 		const float height = 2.0f,
-		const glm::vec3& up = glm::vec3{ 0.0f,  0.0f, 1.0f }
-	) : _center{ center }, _radius{ radius }, _height{ height }, _up{ normalize(up) } {
+		const glm::vec3& up = glm::vec3{ 0.0f,  0.0f, 1.0f },
+		const int segments = SEGMENTS
+	) : _center{ center }, _radius{ radius }, _height{ height }, _up{ normalize(up) }, _segments{ segments } {
 		if (height <= 0.0f) {
 			throw std::exception{ "The height of the cone is not positive\n" };
 		}
@@ -103,6 +180,9 @@ public:
 
 	[[nodiscard]] std::vector<Primitive> primitives() const override;
 
+	// The same shape with half the segments per level, down to MIN_SEGMENTS.
+	[[nodiscard]] std::vector<std::unique_ptr<Drawable>> coarserLevels() const override;
+
 private:
 	const glm::vec3 _center;
 
@@ -112,6 +192,8 @@ private:
 
 	const glm::vec3 _up;
 
+	const int _segments;
+
 	static constexpr auto SEGMENTS = 100;
 };
 
@@ -119,8 +201,10 @@ class BakedStripSphere final : public BakedColorDrawable {
 public:
 	explicit BakedStripSphere(
 		const glm::vec3& center = glm::vec3{ 0.0f, 0.0f, 0.0f },
-		const float radius = 1.0f
-	) : _center{ center }, _radius{ radius } {
+		const float radius = 1.0f,
+		const int segments = SEGMENTS,
+		const int divisions = DIVISIONS
+	) : _center{ center }, _radius{ radius }, _segments{ segments }, _divisions{ divisions } {
 		if (radius <= 0.0f) {
 			throw std::exception{ "The radius of the sphere is not positive\n" };
 		}
@@ -130,14 +214,24 @@ public:
 
 	[[nodiscard]] std::vector<Primitive> primitives() const override;
 
+	// The same shape with half the segments per level, down to MIN_SEGMENTS.
+	[[nodiscard]] std::vector<std::unique_ptr<Drawable>> coarserLevels() const override;
+
 private:
 	const glm::vec3 _center;
 
 	const float _radius;
 
+	const int _segments;
+
+	const int _divisions;
+
 	static constexpr auto SEGMENTS = 50;
 
 	static constexpr auto DIVISIONS = 20;
+
+	// a strip needs at least two rings between the poles
+	static constexpr auto MIN_DIVISIONS = 4;
 };
 
 class BakedCylinder final : public BakedColorDrawable {
@@ -146,8 +240,9 @@ public:
 		const glm::vec3& center = glm::vec3{ 0.0f, 0.0f, -2.0f },
 		const float radius = 2.0f,
 		const float height = 4.0f,
-		const glm::vec3& up = glm::vec3{ 0.0f, 0.0f, 1.0f }
-	) : _center{ center }, _radius{ radius }, _height{ height }, _up{ normalize(up) } {
+		const glm::vec3& up = glm::vec3{ 0.0f, 0.0f, 1.0f },
+		const int segments = SEGMENTS
+	) : _center{ center }, _radius{ radius }, _height{ height }, _up{ normalize(up) }, _segments{ segments } {
 		if (radius <= 0.0f) {
 			throw std::exception{ "The radius of the cylinder is not positive\n" };
 		}
@@ -161,6 +256,9 @@ public:
 
 	[[nodiscard]] std::vector<Primitive> primitives() const override;
 
+	// The same shape with half the segments per level, down to MIN_SEGMENTS.
+	[[nodiscard]] std::vector<std::unique_ptr<Drawable>> coarserLevels() const override;
+
 private:
 	const glm::vec3 _center;
 
@@ -170,6 +268,8 @@ private:
 
 	const glm::vec3 _up;
 
+	const int _segments;
+
 	static constexpr auto SEGMENTS = 100;
 };
 
@@ -181,33 +281,91 @@ public:
 		const glm::vec3& sideDir = glm::vec3{ 1.0f, 0.0f, 0.0f },
 		const float baseLength = 1.0f,
 		const float height = 2.0f
-	) : _baseCenter{ baseCenter }, _up{ upDir }, _side{ sideDir }, _baseLength{ baseLength }, _height{ height } {}
+	) : _geometry{ generate(
+		{ baseCenter.x, baseCenter.y, baseCenter.z }, { upDir.x, upDir.y, upDir.z }, { sideDir.x, sideDir.y, sideDir.z },
+		baseLength, height
+	) } {}
 
 	[[nodiscard]] std::vector<float> vertices() const override;
 
 	[[nodiscard]] std::vector<Primitive> primitives() const override;
 
-private:
-	const glm::vec3 _baseCenter;
-
-	const glm::vec3 _up;
-
-	const glm::vec3 _side;
-
-	const float _baseLength;
+	[[nodiscard]] std::optional<DrawableSize> size() const override;
+
+	void write(VertexWriter& vertices, IndexWriter& indices) const override;
+
+	using Geometry = FixedGeometry<5, 10, 2>;
+
+	static constexpr Geometry generate(
+		const fixed::Point& baseCenter, const fixed::Point& up, const fixed::Point& side,
+		const float baseLength, const float height
+	) {
+		const auto baseRadius = baseLength / std::numbers::sqrt2_v<float>;
+
+		auto geometry = Geometry{
+			{},
+			{
+				0u, 3u, 1u, 2u,				// base
+				4u, 0u, 1u, 2u, 3u, 0u,		// sides
+			},
+			{
+				FixedPrimitive{ GL_TRIANGLE_STRIP, 0, 4 },
+				FixedPrimitive{ GL_TRIANGLE_FAN, 4, 6 },
+			}
+		};
+		// base square
+		fixed::vertex(geometry.vertices, 0, fixed::add(baseCenter, fixed::scale(side, baseRadius)), srgb::RED);
+		fixed::vertex(geometry.vertices, 1, fixed::add(baseCenter, fixed::scale(fixed::normalize(fixed::cross(up, side)), baseRadius)), srgb::BLUE);
+		fixed::vertex(geometry.vertices, 2, fixed::add(baseCenter, fixed::scale(side, -baseRadius)), srgb::GREEN);
+		fixed::vertex(geometry.vertices, 3, fixed::add(baseCenter, fixed::scale(fixed::normalize(fixed::cross(side, up)), baseRadius)), srgb::YELLOW);
+		// top
+		fixed::vertex(geometry.vertices, 4, fixed::add(baseCenter, fixed::scale(up, height)), srgb::MAGENTA);
+		return geometry;
+	}
 
-	const float _height;
+private:
+	const Geometry _geometry;
 };
 
 class BakedMesh final : public BakedColorDrawable {
 public:
 	[[nodiscard]] std::vector<float> vertices() const override;
 
+	// Height fields keep full precision positions, half floats would step visibly over large extents.
+	[[nodiscard]] std::vector<GenericAttribute> layout() const override;
+
 	[[nodiscard]] std::vector<Primitive> primitives() const override;
 
+	// The grid writes straight into upload memory when the engine loads it without optimizing.
+	[[nodiscard]] std::optional<DrawableSize> size() const override;
+
+	void write(VertexWriter& vertices, IndexWriter& indices) const override;
+
+	// Whether the height function depends on time, and the mesh needs animating every frame.
+	[[nodiscard]] bool isAnimated() const;
+
+	// Re-evaluates the heights at the given time, straight into vertices already packed in the mesh layout.
+	// Only the z of each position is written, the rest of the vertex never changes. Returns the bounds
+	// of the surface at that time.
+	MeshBounds animate(float time, std::span<std::byte> vertices) const;
+
+	// Evaluates the heights of a run of points at once: zs[i] = f(xs[i], ys[i], time).
+	// A single call covers a whole row of the grid, so the loop over the points can be inlined and vectorized.
+	using HeightBatch = std::function<void(std::span<const float> xs, std::span<const float> ys, float time, std::span<float> zs)>;
+
 	class Builder {
 	public:
-		explicit Builder(std::function<float(float, float)> func) : _func{ std::move(func) } {}
+		// Accepts any height function, in one of four shapes:
+		// - scalar, float(float x, float y) or float(float x, float y, float t)
+		// - batch, void(span xs, span ys, span zs) or void(span xs, span ys, float t, span zs)
+		// Scalar functions get wrapped in a batch loop here, where their type is still known,
+		// so the compiler inlines them instead of calling through type erasure for every vertex.
+		// Batch functions must spell out their span parameters, generic ones would pass for scalar.
+		template<typename F>
+		explicit Builder(F func) : _func{ toBatch(std::move(func)) }, _animated{ isAnimated<F>() } {}
+
+		// Expressions only animate the mesh if they actually read t.
+		explicit Builder(const HeightExpression& expression) : _func{ expression }, _animated{ expression.usesTime() } {}
 
 		Builder& halfExtentX(const float extent) {
 			_halfExtentX = extent;
@@ -238,11 +396,18 @@ public:
 		}
 
 		[[nodiscard]] BakedMesh build() const {
-			return BakedMesh(_func, _halfExtentX, _halfExtentY, _segmentsX, _segmentsY);
+			return BakedMesh(_func, _animated, _halfExtentX, _halfExtentY, _segmentsX, _segmentsY);
 		}
 
+		// Meshes the same surface with as few triangles as keep within the tolerance of it, see AdaptiveMesh.
+		[[nodiscard]] AdaptiveMesh buildAdaptive(float tolerance) const;
+
+		// A terrain reads the same settings, for grids too large to build in one piece.
+		friend class Terrain;
+
 	private:
-		const std::function<float(float, float)> _func;
+		const HeightBatch _func;
+		const bool _animated;
 		float _halfExtentX{ HALF_EXTENT_X };
 		float _halfExtentY{ HALF_EXTENT_Y };
 		int _segmentsX{ SEGMENTS_X };
@@ -252,22 +417,105 @@ public:
 		static constexpr auto HALF_EXTENT_Y = 10.0f;
 		static constexpr auto SEGMENTS_X = 100;
 		static constexpr auto SEGMENTS_Y = 100;
+
+		template<typename F>
+		static constexpr bool isAnimated() {
+			if constexpr (std::is_invocable_r_v<float, F, float, float>) {
+				return false;
+			} else if constexpr (std::is_invocable_r_v<float, F, float, float, float>) {
+				return true;
+			} else if constexpr (std::is_invocable_v<F, std::span<const float>, std::span<const float>, std::span<float>>) {
+				return false;
+			} else {
+				return true;
+			}
+		}
+
+		template<typename F>
+		static HeightBatch toBatch(F func) {
+			using Xs = std::span<const float>;
+			using Zs = std::span<float>;
+			if constexpr (std::is_invocable_r_v<float, F, float, float>) {
+				return [func = std::move(func)](const Xs xs, const Xs ys, float, const Zs zs) {
+					for (std::size_t i = 0; i < zs.size(); ++i) {
+						zs[i] = func(xs[i], ys[i]);
+					}
+				};
+			} else if constexpr (std::is_invocable_r_v<float, F, float, float, float>) {
+				return [func = std::move(func)](const Xs xs, const Xs ys, const float time, const Zs zs) {
+					for (std::size_t i = 0; i < zs.size(); ++i) {
+						zs[i] = func(xs[i], ys[i], time);
+					}
+				};
+			} else if constexpr (std::is_invocable_v<F, Xs, Xs, Zs>) {
+				return [func = std::move(func)](const Xs xs, const Xs ys, float, const Zs zs) {
+					func(xs, ys, zs);
+				};
+			} else {
+				static_assert(std::is_invocable_v<F, Xs, Xs, float, Zs>, "The height function has none of the accepted shapes");
+				return func;
+			}
+		}
 	};
 
 private:
-	explicit BakedMesh(
-		std::function<float(float, float)> func,
-		const float halfExtentX, 
-		const float halfExtentY,
-		const int segmentsX, 
-		const int segmentsY
-	) : _func{ std::move(func) }, _halfExtentX{ halfExtentX }, _halfExtentY{ halfExtentY },
-	_segmentsX{ segmentsX }, _segmentsY{ segmentsY } {}
+	BakedMesh(HeightBatch func, bool animated, float halfExtentX, float halfExtentY, int segmentsX, int segmentsY);
+
+	const HeightBatch _func;
+	const bool _animated;
 
-	const std::function<float(float, float)> _func;
+	// Evaluates one row of constant x into zs, the y of each point coming from the column table.
+	void evaluateRow(float x, std::span<const float> ys, float time, std::span<float> zs) const;
+
+	// The y coordinate of every column of the grid.
+	[[nodiscard]] static std::vector<float> columnCoordinates(float halfExtentY, int segmentsY);
 
 	const float _halfExtentX;
 	const float _halfExtentY;
 	const int _segmentsX;
 	const int _segmentsY;
+
+	// Everything about the grid that does not depend on the heights, worked out once rather than
+	// on every frame the mesh animates.
+	const std::vector<float> _ys;
+	const std::vector<int> _rows;
+	const std::size_t _stride;
+};
+
+// A height field meshed only as finely as the surface needs, instead of on a uniform lattice.
+// The lattice of the builder, rounded up to a power of two of segments, gets triangulated as a right-triangulated
+// irregular network, each triangle splitting in two along its longest edge for as long as the surface strays
+// from it by more than the tolerance somewhere. A split forces the neighbour across that edge to split too,
+// so the result never has cracks. Flat areas end up with a handful of large triangles, detailed ones
+// with as many as the lattice has.
+class AdaptiveMesh final : public BakedColorDrawable {
+public:
+	[[nodiscard]] std::vector<float> vertices() const override;
+
+	// Full precision positions, as with BakedMesh.
+	[[nodiscard]] std::vector<GenericAttribute> layout() const override;
+
+	[[nodiscard]] std::vector<Primitive> primitives() const override;
+
+	[[nodiscard]] std::optional<DrawableSize> size() const override;
+
+	void write(VertexWriter& vertices, IndexWriter& indices) const override;
+
+	[[nodiscard]] std::size_t getTriangleCount() const;
+
+	// How many triangles the uniform lattice the mesh was refined from has, that is the builder's lattice
+	// with its longer side rounded up to a power of two along both sides.
+	[[nodiscard]] std::size_t getLatticeTriangleCount() const;
+
+	friend class BakedMesh::Builder;
+
+private:
+	// Animated height functions get sampled at the start of time.
+	AdaptiveMesh(const BakedMesh::HeightBatch& func, float halfExtentX, float halfExtentY, int segments, float tolerance);
+
+	// Interleaved positions and colors, and the triangles over them.
+	std::vector<float> _vertices{};
+	std::vector<IndexType> _indices{};
+
+	std::size_t _latticeTriangles{ 0 };
 };
\ No newline at end of file
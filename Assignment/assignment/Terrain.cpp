@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <ranges>
+#include <stdexcept>
+
+#include "Terrain.h"
+#include "../Frustum.h"
+#include "../Shader.h"
+#include "../drawable/Color.h"
+
+static float distanceToBox(const glm::vec3& point, const glm::vec3& min, const glm::vec3& max) {
+	return glm::distance(point, glm::clamp(point, min, max));
+}
+
+TerrainChunk::TerrainChunk(
+	const glm::vec2 min,
+	const glm::vec2 max,
+	const int segments,
+	std::vector<float> heights,
+	std::vector<float> coarseHeights,
+	const float morphEnd
+) : Drawable(loadShader()), _min{ min }, _max{ max }, _segments{ segments }, _heights{ std::move(heights) },
+_coarseHeights{ std::move(coarseHeights) }, _morphEnd{ morphEnd } {}
+
+std::vector<float> TerrainChunk::vertices() const {
+	auto vertices = std::vector<float>{};
+	vertices.reserve(_heights.size() * COMPONENTS);
+	for (auto i = 0; i < _segments + 1; ++i) {
+		for (auto j = 0; j < _segments + 1; ++j) {
+			const auto components = vertex(i, j);
+			vertices.insert(vertices.end(), components.begin(), components.end());
+		}
+	}
+	return vertices;
+}
+
+std::vector<GenericAttribute> TerrainChunk::layout() const {
+	return std::vector{
+		GenericAttribute{ AttributeSize::VEC_3, true },									// position
+		GenericAttribute{ AttributeSize::VEC_3, true, AttributeType::UNSIGNED_BYTE },	// color
+		GenericAttribute{ AttributeSize::VEC_2, false }									// coarser height, morph end
+	};
+}
+
+std::vector<Primitive> TerrainChunk::primitives() const {
+	auto primitives = std::vector<Primitive>{};
+	primitives.reserve(_segments);
+
+	// the same strips as BakedMesh, the morph relies on every level splitting its quads along the same diagonal
+	for (auto i = 0; i < _segments; ++i) {
+		auto indices = std::vector<IndexType>(2 * static_cast<std::size_t>(_segments + 1));
+		for (auto j = 0; j < _segments + 1; ++j) {
+			indices[2 * j] = j + i * (_segments + 1);
+			indices[2 * j + 1] = j + (i + 1) * (_segments + 1);
+		}
+		primitives.emplace_back(GL_TRIANGLE_STRIP, std::move(indices));
+	}
+	return primitives;
+}
+
+std::optional<DrawableSize> TerrainChunk::size() const {
+	const auto stripIndices = 2 * static_cast<std::size_t>(_segments + 1);
+	return DrawableSize{
+		_heights.size(),
+		std::vector(static_cast<std::size_t>(_segments), PrimitiveSize{ GL_TRIANGLE_STRIP, stripIndices })
+	};
+}
+
+void TerrainChunk::write(VertexWriter& vertices, IndexWriter& indices) const {
+	for (auto i = 0; i < _segments + 1; ++i) {
+		for (auto j = 0; j < _segments + 1; ++j) {
+			vertices.write(vertex(i, j));
+		}
+	}
+
+	for (auto i = 0; i < _segments; ++i) {
+		for (auto j = 0; j < _segments + 1; ++j) {
+			indices.write(j + i * (_segments + 1));
+			indices.write(j + (i + 1) * (_segments + 1));
+		}
+	}
+}
+
+GLuint TerrainChunk::loadShader() {
+	static const auto program = Shader::createProgram(VERT_SHADER_PATH, FRAG_SHADER_PATH);
+	return program;
+}
+
+std::array<float, TerrainChunk::COMPONENTS> TerrainChunk::vertex(const int i, const int j) const {
+	const auto step = (_max - _min) / static_cast<float>(_segments);
+	const auto index = static_cast<std::size_t>(i * (_segments + 1) + j);
+	return {
+		_min.x + static_cast<float>(i) * step.x, _max.y - static_cast<float>(j) * step.y, _heights[index],
+		srgb::YELLOW[0], srgb::YELLOW[1], srgb::YELLOW[2],
+		_coarseHeights[index], _morphEnd
+	};
+}
+
+Terrain::Terrain(const BakedMesh::Builder& builder, Engine& engine, Scene& scene)
+	: _func{ builder._func }, _engine{ engine }, _scene{ scene }, _halfExtent{ builder._halfExtentX, builder._halfExtentY } {
+	if (_halfExtent.x <= 0.0f || _halfExtent.y <= 0.0f) {
+		throw std::invalid_argument("The terrain must have a positive extent.");
+	}
+
+	// deep enough that the finest chunks are at least as dense as the segments asked for
+	const auto segments = std::max(builder._segmentsX, builder._segmentsY);
+	while (_depth < MAX_DEPTH && (CHUNK_SEGMENTS << _depth) < segments) {
+		++_depth;
+	}
+
+	// the root is always there to fall back on, whatever has not loaded yet
+	loadChunk(makeKey(0, 0, 0));
+}
+
+Terrain::~Terrain() {
+	for (auto& chunk : _chunks | std::views::values) {
+		unloadChunk(chunk);
+	}
+}
+
+void Terrain::update(const Camera& camera) {
+	++_updates;
+
+	const auto viewMatrix = camera.getViewMatrix();
+	const auto viewer = glm::vec3{ glm::inverse(viewMatrix)[3] };
+
+	_selection.clear();
+	_requests.clear();
+	select(makeKey(0, 0, 0), viewer);
+
+	// the nodes that could not split this time get their children next time, the nearest first
+	std::ranges::sort(_requests, {}, &std::pair<float, NodeKey>::first);
+	const auto loads = std::min(_requests.size(), static_cast<std::size_t>(LOADS_PER_UPDATE));
+	for (std::size_t r = 0; r < loads; ++r) {
+		loadChunk(_requests[r].second);
+	}
+
+	const auto frustum = Frustum{ camera.getProjection() * viewMatrix };
+	_visibleCount = 0;
+	for (const auto key : _selection) {
+		if (auto& chunk = _chunks.at(key); frustum.intersects(chunk.min, chunk.max)) {
+			chunk.lastDrawn = _updates;
+			++_visibleCount;
+		}
+	}
+
+	// only the chunks drawn this time stay in the scene
+	for (auto& chunk : _chunks | std::views::values) {
+		if (const auto drawn = chunk.lastDrawn == _updates; drawn != chunk.inScene) {
+			if (drawn) {
+				_scene.addEntity(chunk.entity);
+			} else {
+				_scene.remove(chunk.entity);
+			}
+			chunk.inScene = drawn;
+		}
+	}
+
+	evict();
+}
+
+int Terrain::getLevelCount() const {
+	return _depth + 1;
+}
+
+std::size_t Terrain::getLoadedChunkCount() const {
+	return _chunks.size();
+}
+
+std::size_t Terrain::getVisibleChunkCount() const {
+	return _visibleCount;
+}
+
+Terrain::NodeKey Terrain::makeKey(const int depth, const std::uint32_t x, const std::uint32_t y) {
+	return static_cast<NodeKey>(depth) << 56 | static_cast<NodeKey>(x) << 28 | y;
+}
+
+int Terrain::depthOf(const NodeKey key) {
+	return static_cast<int>(key >> 56);
+}
+
+glm::vec2 Terrain::nodeMin(const NodeKey key) const {
+	const auto x = static_cast<float>(key >> 28 & 0xFFFFFFF);
+	const auto y = static_cast<float>(key & 0xFFFFFFF);
+	return -_halfExtent + glm::vec2{ x, y } * nodeSize(depthOf(key));
+}
+
+glm::vec2 Terrain::nodeSize(const int depth) const {
+	return _halfExtent * 2.0f / static_cast<float>(1u << depth);
+}
+
+float Terrain::lodRange(const int depth) const {
+	const auto size = nodeSize(depth);
+	return LOD_RANGE * std::max(size.x, size.y);
+}
+
+void Terrain::select(const NodeKey key, const glm::vec3& viewer) {
+	auto& chunk = _chunks.at(key);
+	chunk.lastUsed = _updates;
+
+	const auto depth = depthOf(key);
+	if (depth < _depth && distanceToBox(viewer, chunk.min, chunk.max) < lodRange(depth + 1)) {
+		const auto x = static_cast<std::uint32_t>(key >> 28 & 0xFFFFFFF) * 2;
+		const auto y = static_cast<std::uint32_t>(key & 0xFFFFFFF) * 2;
+		const auto children = std::array{
+			makeKey(depth + 1, x, y), makeKey(depth + 1, x + 1, y),
+			makeKey(depth + 1, x, y + 1), makeKey(depth + 1, x + 1, y + 1)
+		};
+
+		auto ready = true;
+		for (const auto child : children) {
+			if (const auto it = _chunks.find(child); it != _chunks.end()) {
+				// keep the ones already there around until their siblings catch up
+				it->second.lastUsed = _updates;
+			} else {
+				// the child's heights are unknown until it is generated, the parent's bound them closely enough
+				const auto min = nodeMin(child);
+				const auto max = min + nodeSize(depth + 1);
+				const auto distance = distanceToBox(viewer, glm::vec3{ min, chunk.min.z }, glm::vec3{ max, chunk.max.z });
+				_requests.emplace_back(distance, child);
+				ready = false;
+			}
+		}
+
+		// the node stands in for its children, coarser than it should be, until all four are loaded
+		if (ready) {
+			for (const auto child : children) {
+				select(child, viewer);
+			}
+			return;
+		}
+	}
+
+	_selection.push_back(key);
+}
+
+void Terrain::loadChunk(const NodeKey key) {
+	const auto depth = depthOf(key);
+	const auto min = nodeMin(key);
+	const auto max = min + nodeSize(depth);
+	const auto step = (max - min) / static_cast<float>(CHUNK_SEGMENTS);
+	constexpr auto rowVertices = static_cast<std::size_t>(CHUNK_SEGMENTS + 1);
+
+	// the same order as BakedMesh, rows of constant x from the least x, each from the most y
+	auto ys = std::vector<float>(rowVertices);
+	for (std::size_t j = 0; j < rowVertices; ++j) {
+		ys[j] = max.y - static_cast<float>(j) * step.y;
+	}
+
+	auto heights = std::vector<float>(rowVertices * rowVertices);
+	auto xs = std::vector<float>(rowVertices);
+	for (std::size_t i = 0; i < rowVertices; ++i) {
+		std::ranges::fill(xs, min.x + static_cast<float>(i) * step.x);
+		_func(xs, ys, 0.0f, std::span{ heights }.subspan(i * rowVertices, rowVertices));
+	}
+
+	// Every other vertex lies on the coarser level as well, the rest lie on an edge or diagonal of its triangles,
+	// where it has the mean of the two ends. The root has no coarser level to morph into.
+	const auto at = [&](const std::size_t i, const std::size_t j) { return heights[i * rowVertices + j]; };
+	auto coarseHeights = heights;
+	if (depth > 0) {
+		for (std::size_t i = 0; i < rowVertices; ++i) {
+			for (std::size_t j = 0; j < rowVertices; ++j) {
+				auto& height = coarseHeights[i * rowVertices + j];
+				if (i % 2 == 1 && j % 2 == 1) {
+					height = (at(i + 1, j - 1) + at(i - 1, j + 1)) * 0.5f;
+				} else if (i % 2 == 1) {
+					height = (at(i - 1, j) + at(i + 1, j)) * 0.5f;
+				} else if (j % 2 == 1) {
+					height = (at(i, j - 1) + at(i, j + 1)) * 0.5f;
+				}
+			}
+		}
+	}
+
+	const auto [lowest, highest] = std::ranges::minmax(heights);
+	const auto chunk = TerrainChunk(min, max, CHUNK_SEGMENTS, std::move(heights), std::move(coarseHeights), lodRange(depth));
+	const auto renderable = _engine.loadMesh(chunk, Engine::DIRECT_LOAD_OPTIONS);
+	const auto entity = EntityManager::get()->create();
+	RenderableManager::Builder(renderable).build(_engine, entity);
+	_chunks.emplace(key, Chunk{
+		renderable, entity, glm::vec3{ min, lowest }, glm::vec3{ max, highest }, _updates, 0, false
+	});
+}
+
+void Terrain::unloadChunk(Chunk& chunk) const {
+	if (chunk.inScene) {
+		_scene.remove(chunk.entity);
+		chunk.inScene = false;
+	}
+	_engine.getRenderableManager()->destroy(chunk.entity);
+	_engine.unloadMesh(chunk.renderable);
+	EntityManager::get()->discard(chunk.entity);
+}
+
+void Terrain::evict() {
+	if (_chunks.size() <= MAX_CHUNKS) {
+		return;
+	}
+
+	// anything walked through this update is in use, the root included
+	auto stale = std::vector<std::pair<std::uint64_t, NodeKey>>{};
+	for (const auto& [key, chunk] : _chunks) {
+		if (chunk.lastUsed != _updates) {
+			stale.emplace_back(chunk.lastUsed, key);
+		}
+	}
+	std::ranges::sort(stale);
+
+	const auto evictions = std::min(stale.size(), _chunks.size() - MAX_CHUNKS);
+	for (std::size_t e = 0; e < evictions; ++e) {
+		const auto it = _chunks.find(stale[e].second);
+		unloadChunk(it->second);
+		_chunks.erase(it);
+	}
+}
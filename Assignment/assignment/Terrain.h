@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "PackageOne.h"
+#include "../Camera.h"
+#include "../Engine.h"
+#include "../Scene.h"
+#include "../drawable/Drawable.h"
+
+// One square of a terrain, a fixed size grid of its own heights along with the heights the same points
+// take on the next coarser level, which the vertices morph into as the viewer moves away.
+class TerrainChunk final : public Drawable {
+public:
+	// The heights go row by row of constant x, from the least x, each row from the most y,
+	// (segments + 1) ^ 2 of them as with BakedMesh.
+	TerrainChunk(
+		glm::vec2 min,
+		glm::vec2 max,
+		int segments,
+		std::vector<float> heights,
+		std::vector<float> coarseHeights,
+		float morphEnd
+	);
+
+	[[nodiscard]] std::vector<float> vertices() const override;
+
+	[[nodiscard]] std::vector<GenericAttribute> layout() const override;
+
+	[[nodiscard]] std::vector<Primitive> primitives() const override;
+
+	[[nodiscard]] std::optional<DrawableSize> size() const override;
+
+	void write(VertexWriter& vertices, IndexWriter& indices) const override;
+
+private:
+	static constexpr auto VERT_SHADER_PATH = "shaders/terrain.vert";
+
+	static constexpr auto FRAG_SHADER_PATH = "shaders/baked.frag";
+
+	static [[nodiscard]] GLuint loadShader();
+
+	static constexpr auto COMPONENTS = std::size_t{ 8 };
+
+	[[nodiscard]] std::array<float, COMPONENTS> vertex(int i, int j) const;
+
+	const glm::vec2 _min;
+	const glm::vec2 _max;
+	const int _segments;
+	const std::vector<float> _heights;
+	const std::vector<float> _coarseHeights;
+	const float _morphEnd;
+};
+
+// A height field too large to build as a single grid, drawn as a quadtree of equally sized chunks instead.
+// Chunks nearer the viewer come from deeper, finer levels of the tree, and each morphs into the next coarser
+// level as it nears the distance that level takes over at, so switching levels never pops.
+// Chunks are only generated once the viewer first comes near enough to need them, a few per update,
+// and the least recently used get dropped once there are more than a fixed budget of them.
+class Terrain {
+public:
+	// The extents of the builder cover the whole terrain, and its segments set the spacing of the finest level.
+	// The terrain is static, animated height functions get sampled at the start of time.
+	Terrain(const BakedMesh::Builder& builder, Engine& engine, Scene& scene);
+
+	// Must go before the engine is destroyed, as it unloads its chunks.
+	~Terrain();
+	Terrain(const Terrain&) = delete;
+	Terrain(Terrain&&) noexcept = delete;
+	Terrain& operator=(const Terrain&) = delete;
+	Terrain& operator=(Terrain&&) noexcept = delete;
+
+	// Picks the chunks to draw for the camera, loading what is missing and keeping the scene in sync.
+	// Chunks outside the view frustum stay out of the scene. Call once a frame, before rendering.
+	void update(const Camera& camera);
+
+	[[nodiscard]] int getLevelCount() const;
+
+	[[nodiscard]] std::size_t getLoadedChunkCount() const;
+
+	[[nodiscard]] std::size_t getVisibleChunkCount() const;
+
+	// Segments along each side of a chunk, even so that every other vertex also lies on the coarser level.
+	static constexpr auto CHUNK_SEGMENTS = 32;
+
+	// A level is drawn up to this many of its chunk sizes away from the viewer, past which the coarser one takes over.
+	static constexpr auto LOD_RANGE = 5.0f;
+
+	// The share of that range after which a chunk starts morphing, matches the terrain vertex shader.
+	static constexpr auto MORPH_START = 0.8f;
+
+	// How many missing chunks get generated per update, nearest first, to keep frame times even.
+	static constexpr auto LOADS_PER_UPDATE = 16;
+
+	// How many chunks may stay loaded before the least recently used get dropped.
+	static constexpr auto MAX_CHUNKS = std::size_t{ 1024 };
+
+private:
+	// Depth in the tree, from the root, and position among the nodes of that depth.
+	using NodeKey = std::uint64_t;
+
+	struct Chunk {
+		Renderable renderable;
+		Entity entity;
+		glm::vec3 min;
+		glm::vec3 max;
+		std::uint64_t lastUsed;		// the last update that walked through the node
+		std::uint64_t lastDrawn;	// the last update that selected the chunk inside the frustum
+		bool inScene;
+	};
+
+	static constexpr auto MAX_DEPTH = 24;
+
+	static [[nodiscard]] NodeKey makeKey(int depth, std::uint32_t x, std::uint32_t y);
+
+	static [[nodiscard]] int depthOf(NodeKey key);
+
+	[[nodiscard]] glm::vec2 nodeMin(NodeKey key) const;
+
+	[[nodiscard]] glm::vec2 nodeSize(int depth) const;
+
+	// The distance up to which nodes of the given depth get drawn.
+	[[nodiscard]] float lodRange(int depth) const;
+
+	// Walks down from the node, selecting it or, when the viewer is near enough, its children.
+	void select(NodeKey key, const glm::vec3& viewer);
+
+	void loadChunk(NodeKey key);
+
+	void unloadChunk(Chunk& chunk) const;
+
+	void evict();
+
+	BakedMesh::HeightBatch _func;
+	Engine& _engine;
+	Scene& _scene;
+
+	const glm::vec2 _halfExtent;
+
+	// The finest level, the root being at depth 0.
+	int _depth{ 0 };
+
+	std::unordered_map<NodeKey, Chunk> _chunks{};
+
+	std::uint64_t _updates{ 0 };
+
+	// Rebuilt every update, kept here so they do not reallocate.
+	std::vector<NodeKey> _selection{};
+
+	std::vector<std::pair<float, NodeKey>> _requests{};
+
+	std::size_t _visibleCount{ 0 };
+};
@@ -1,29 +1,58 @@
+#include <cstring>
+#include <stdexcept>
+
 #include "Drawable.h"
 #include "Vertex.h"
+#include "../MeshOptimizer.h"
 #include "../Shader.h"
 
 std::vector<GenericAttribute> BakedColorDrawable::layout() const {
 	return std::vector{
-		GenericAttribute{ AttributeSize::VEC_3, true },
-		GenericAttribute{ AttributeSize::VEC_3, true }
+		GenericAttribute{ AttributeSize::VEC_3, true, AttributeType::HALF_FLOAT },	// position
+		GenericAttribute{ AttributeSize::VEC_3, true, AttributeType::UNSIGNED_BYTE }	// color
 	};
 }
 
 GLuint BakedColorDrawable::loadBakedColorShader() {
-	return Shader::createProgram(VERT_SHADER_PATH, FRAG_SHADER_PATH);
+	// every drawable of the kind shares one program, so their draws stay in the same state bucket
+	static const auto program = Shader::createProgram(VERT_SHADER_PATH, FRAG_SHADER_PATH);
+	return program;
 }
 
 std::vector<GenericAttribute> TexturedDrawable::layout() const {
 	return std::vector{
-		GenericAttribute{ AttributeSize::VEC_3, true },
-		GenericAttribute{ AttributeSize::VEC_2, true }
+		GenericAttribute{ AttributeSize::VEC_3, true, AttributeType::HALF_FLOAT },		// position
+		GenericAttribute{ AttributeSize::VEC_2, true, AttributeType::UNSIGNED_SHORT }	// uv in [0; 1]
 	};
 }
 
 GLuint TexturedDrawable::loadShader() {
-	return Shader::createProgram(VERT_SHADER_PATH, FRAG_SHADER_PATH);
+	static const auto program = Shader::createProgram(VERT_SHADER_PATH, FRAG_SHADER_PATH);
+	return program;
 }
 
+IndexWriter::IndexWriter(const std::span<std::byte> destination, const GLenum indexType)
+	: _destination{ destination }, _indexType{ indexType } {}
+
+void IndexWriter::write(const IndexType index) {
+	if (_indexType == GL_UNSIGNED_SHORT) {
+		if ((_count + 1) * sizeof(GLushort) > _destination.size()) {
+			throw std::out_of_range("More indices written than were reserved.");
+		}
+		const auto value = index == MeshOptimizer::RESTART_INDEX
+			? static_cast<GLushort>(MeshOptimizer::SHORT_RESTART_INDEX)
+			: static_cast<GLushort>(index);
+		std::memcpy(_destination.data() + _count * sizeof(value), &value, sizeof(value));
+	} else {
+		if ((_count + 1) * sizeof(GLuint) > _destination.size()) {
+			throw std::out_of_range("More indices written than were reserved.");
+		}
+		const auto value = static_cast<GLuint>(index);
+		std::memcpy(_destination.data() + _count * sizeof(value), &value, sizeof(value));
+	}
+	++_count;
+}
 
-
-
+std::size_t IndexWriter::getCount() const {
+	return _count;
+}
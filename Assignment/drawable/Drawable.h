@@ -1,6 +1,10 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
 #include <vector>
 
 #include "Vertex.h"
@@ -12,6 +16,35 @@ struct Primitive {
 	const std::vector<IndexType> indices;
 };
 
+// The exact number of vertices, and of indices per primitive, a drawable writes through its sink.
+struct PrimitiveSize {
+	const int topology;
+	const std::size_t indexCount;
+};
+
+struct DrawableSize {
+	const std::size_t vertexCount;
+	const std::vector<PrimitiveSize> primitives;
+};
+
+// Writes indices one at a time into memory reserved for them up front, in whichever width the engine
+// picked, mapping MeshOptimizer::RESTART_INDEX onto the restart index of that width.
+class IndexWriter {
+public:
+	IndexWriter(std::span<std::byte> destination, GLenum indexType);
+
+	void write(IndexType index);
+
+	[[nodiscard]] std::size_t getCount() const;
+
+private:
+	const std::span<std::byte> _destination;
+
+	const GLenum _indexType;
+
+	std::size_t _count{ 0 };
+};
+
 class Drawable {
 public:
 	virtual ~Drawable() = default;
@@ -25,6 +58,17 @@ public:
 	[[nodiscard]] virtual std::vector<float> vertices() const = 0;
 	[[nodiscard]] virtual std::vector<GenericAttribute> layout() const = 0;
 	[[nodiscard]] virtual std::vector<Primitive> primitives() const = 0;
+
+	// Drawables knowing their exact size up front may also write themselves straight into upload memory,
+	// sparing the copies vertices() and primitives() return. The engine only asks when it has no pass to
+	// run over the whole mesh, and then calls write with exactly as much room as size reported, the
+	// indices of the primitives following each other in order.
+	[[nodiscard]] virtual std::optional<DrawableSize> size() const { return std::nullopt; }
+	virtual void write(VertexWriter&, IndexWriter&) const {}
+
+	// Coarser versions of the same shape, from finer to coarser, the drawable itself being the finest.
+	// The engine loads them all and the renderer draws whichever fits the size of the shape on screen.
+	[[nodiscard]] virtual std::vector<std::unique_ptr<Drawable>> coarserLevels() const { return {}; }
 };
 
 class BakedColorDrawable : public Drawable {
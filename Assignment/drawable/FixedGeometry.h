@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Drawable.h"
+
+// A primitive of fixed geometry, as a run of its index array.
+struct FixedPrimitive {
+	int topology;
+	std::size_t first;
+	std::size_t count;
+};
+
+// Geometry of a size known at compile time: interleaved positions and colors, indices and primitives in
+// arrays, so constexpr functions can generate it and drawables keep it without touching the heap.
+template<std::size_t VertexCount, std::size_t IndexCount, std::size_t PrimitiveCount>
+struct FixedGeometry {
+	static constexpr std::size_t COMPONENTS = 6;	// position and color
+
+	std::array<float, VertexCount * COMPONENTS> vertices;
+	std::array<IndexType, IndexCount> indices;
+	std::array<FixedPrimitive, PrimitiveCount> primitives;
+
+	[[nodiscard]] std::vector<float> toVertices() const {
+		return { vertices.begin(), vertices.end() };
+	}
+
+	[[nodiscard]] std::vector<Primitive> toPrimitives() const {
+		auto result = std::vector<Primitive>{};
+		result.reserve(PrimitiveCount);
+		for (const auto& [topology, first, count] : primitives) {
+			const auto begin = indices.begin() + static_cast<std::ptrdiff_t>(first);
+			result.emplace_back(topology, std::vector<IndexType>(begin, begin + static_cast<std::ptrdiff_t>(count)));
+		}
+		return result;
+	}
+
+	[[nodiscard]] DrawableSize size() const {
+		auto sizes = std::vector<PrimitiveSize>{};
+		sizes.reserve(PrimitiveCount);
+		for (const auto& [topology, first, count] : primitives) {
+			sizes.push_back(PrimitiveSize{ topology, count });
+		}
+		return DrawableSize{ VertexCount, std::move(sizes) };
+	}
+
+	// Writes straight from the arrays, the primitives are laid out one after the other already.
+	void write(VertexWriter& vertexWriter, IndexWriter& indexWriter) const {
+		for (std::size_t v = 0; v < VertexCount; ++v) {
+			vertexWriter.write(std::span{ vertices.data() + v * COMPONENTS, COMPONENTS });
+		}
+		for (const auto index : indices) {
+			indexWriter.write(index);
+		}
+	}
+};
+
+// The bits of vector math fixed geometry needs, usable in constant expressions unlike glm's.
+namespace fixed {
+	using Point = std::array<float, 3>;
+
+	constexpr Point add(const Point& a, const Point& b) {
+		return { a[0] + b[0], a[1] + b[1], a[2] + b[2] };
+	}
+
+	constexpr Point scale(const Point& a, const float s) {
+		return { a[0] * s, a[1] * s, a[2] * s };
+	}
+
+	constexpr Point cross(const Point& a, const Point& b) {
+		return { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+	}
+
+	constexpr float sqrt(const float x) {
+		if (!std::is_constant_evaluated()) {
+			return std::sqrt(x);
+		}
+		if (x <= 0.0f) {
+			return 0.0f;
+		}
+		// Newton's iterations, converging from above
+		auto root = x > 1.0f ? x : 1.0f;
+		for (auto i = 0; i < 64; ++i) {
+			root = 0.5f * (root + x / root);
+		}
+		return root;
+	}
+
+	constexpr Point normalize(const Point& a) {
+		return scale(a, 1.0f / sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]));
+	}
+
+	// Writes a position and a color into the vertex array, at the given vertex.
+	template<std::size_t N>
+	constexpr void vertex(std::array<float, N>& vertices, const std::size_t index, const Point& position, const float* color) {
+		const auto offset = index * 6;
+		vertices[offset] = position[0];
+		vertices[offset + 1] = position[1];
+		vertices[offset + 2] = position[2];
+		vertices[offset + 3] = color[0];
+		vertices[offset + 4] = color[1];
+		vertices[offset + 5] = color[2];
+	}
+}
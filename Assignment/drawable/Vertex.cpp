@@ -0,0 +1,204 @@
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "Vertex.h"
+
+std::size_t attributeBytes(const GenericAttribute& attribute) {
+	const auto components = static_cast<std::size_t>(attribute.size);
+	std::size_t bytes = 0;
+	switch (attribute.type) {
+	case AttributeType::FLOAT:
+		bytes = components * sizeof(float);
+		break;
+	case AttributeType::HALF_FLOAT:
+	case AttributeType::UNSIGNED_SHORT:
+		bytes = components * sizeof(std::uint16_t);
+		break;
+	case AttributeType::UNSIGNED_BYTE:
+		bytes = components * sizeof(std::uint8_t);
+		break;
+	case AttributeType::INT_2_10_10_10_REV:
+		bytes = sizeof(std::uint32_t);
+		break;
+	}
+	// keep every attribute 4-byte aligned, as vertex fetch is much faster that way
+	return (bytes + 3) & ~static_cast<std::size_t>(3);
+}
+
+std::size_t vertexStride(const std::vector<GenericAttribute>& layout) {
+	std::size_t stride = 0;
+	for (const auto& attribute : layout) {
+		stride += attributeBytes(attribute);
+	}
+	return stride;
+}
+
+std::size_t vertexComponents(const std::vector<GenericAttribute>& layout) {
+	std::size_t components = 0;
+	for (const auto& attribute : layout) {
+		components += static_cast<std::size_t>(attribute.size);
+	}
+	return components;
+}
+
+std::vector<std::byte> packVertices(const std::vector<float>& vertices, const std::vector<GenericAttribute>& layout) {
+	// zero-initialized, so the padding bytes are deterministic
+	auto packed = std::vector<std::byte>(vertices.size() / vertexComponents(layout) * vertexStride(layout));
+	packVertices(vertices, layout, packed);
+	return packed;
+}
+
+std::size_t packVertices(
+	const std::vector<float>& vertices,
+	const std::vector<GenericAttribute>& layout,
+	const std::span<std::byte> destination
+) {
+	const auto components = vertexComponents(layout);
+	const auto stride = vertexStride(layout);
+	const auto vertexCount = vertices.size() / components;
+	if (vertexCount * stride > destination.size()) {
+		throw std::invalid_argument("The packed vertices do not fit in the destination.");
+	}
+
+	for (std::size_t v = 0; v < vertexCount; ++v) {
+		packVertex(vertices.data() + v * components, layout, destination.data() + v * stride);
+	}
+	return vertexCount * stride;
+}
+
+void packVertex(const float* source, const std::vector<GenericAttribute>& layout, std::byte* output) {
+	for (const auto& attribute : layout) {
+		const auto size = static_cast<std::size_t>(attribute.size);
+		switch (attribute.type) {
+		case AttributeType::FLOAT:
+			std::memcpy(output, source, size * sizeof(float));
+			break;
+		case AttributeType::HALF_FLOAT:
+			for (std::size_t c = 0; c < size; ++c) {
+				const auto half = glm::packHalf1x16(source[c]);
+				std::memcpy(output + c * sizeof(half), &half, sizeof(half));
+			}
+			break;
+		case AttributeType::UNSIGNED_SHORT:
+			for (std::size_t c = 0; c < size; ++c) {
+				const auto value = glm::packUnorm1x16(source[c]);
+				std::memcpy(output + c * sizeof(value), &value, sizeof(value));
+			}
+			break;
+		case AttributeType::UNSIGNED_BYTE:
+			for (std::size_t c = 0; c < size; ++c) {
+				const auto value = glm::packUnorm1x8(source[c]);
+				std::memcpy(output + c * sizeof(value), &value, sizeof(value));
+			}
+			break;
+		case AttributeType::INT_2_10_10_10_REV: {
+			auto xyzw = glm::vec4{ 0.0f };
+			for (std::size_t c = 0; c < std::min<std::size_t>(size, 4); ++c) {
+				xyzw[static_cast<int>(c)] = source[c];
+			}
+			const auto value = glm::packSnorm3x10_1x2(xyzw);
+			std::memcpy(output, &value, sizeof(value));
+			break;
+		}
+		}
+		source += size;
+		output += attributeBytes(attribute);
+	}
+}
+
+void unpackAttribute(const std::byte* input, const GenericAttribute& attribute, float* output) {
+	const auto size = static_cast<std::size_t>(attribute.size);
+	switch (attribute.type) {
+	case AttributeType::FLOAT:
+		std::memcpy(output, input, size * sizeof(float));
+		break;
+	case AttributeType::HALF_FLOAT:
+		for (std::size_t c = 0; c < size; ++c) {
+			auto half = glm::uint16{ 0 };
+			std::memcpy(&half, input + c * sizeof(half), sizeof(half));
+			output[c] = glm::unpackHalf1x16(half);
+		}
+		break;
+	case AttributeType::UNSIGNED_SHORT:
+		for (std::size_t c = 0; c < size; ++c) {
+			auto value = glm::uint16{ 0 };
+			std::memcpy(&value, input + c * sizeof(value), sizeof(value));
+			output[c] = glm::unpackUnorm1x16(value);
+		}
+		break;
+	case AttributeType::UNSIGNED_BYTE:
+		for (std::size_t c = 0; c < size; ++c) {
+			auto value = glm::uint8{ 0 };
+			std::memcpy(&value, input + c * sizeof(value), sizeof(value));
+			output[c] = glm::unpackUnorm1x8(value);
+		}
+		break;
+	case AttributeType::INT_2_10_10_10_REV: {
+		auto value = glm::uint32{ 0 };
+		std::memcpy(&value, input, sizeof(value));
+		const auto xyzw = glm::unpackSnorm3x10_1x2(value);
+		for (std::size_t c = 0; c < std::min<std::size_t>(size, 4); ++c) {
+			output[c] = xyzw[static_cast<int>(c)];
+		}
+		break;
+	}
+	}
+}
+
+VertexWriter::VertexWriter(const std::span<std::byte> destination, std::vector<GenericAttribute> layout)
+	: _destination{ destination }, _layout{ std::move(layout) }, _stride{ vertexStride(_layout) },
+	_components{ vertexComponents(_layout) } {}
+
+void VertexWriter::write(const std::span<const float> components) {
+	if (components.size() != _components) {
+		throw std::invalid_argument("The vertex does not match the layout.");
+	}
+	if ((_count + 1) * _stride > _destination.size()) {
+		throw std::out_of_range("More vertices written than were reserved.");
+	}
+	packVertex(components.data(), _layout, _destination.data() + _count * _stride);
+
+	for (std::size_t c = 0; c < std::min<std::size_t>(3, components.size()); ++c) {
+		_min[c] = _count == 0 ? components[c] : std::min(_min[c], components[c]);
+		_max[c] = _count == 0 ? components[c] : std::max(_max[c], components[c]);
+	}
+	++_count;
+}
+
+void VertexWriter::writeAt(const std::size_t offset, const std::span<const float> components) const {
+	if (components.size() != _components) {
+		throw std::invalid_argument("The vertex does not match the layout.");
+	}
+	if ((_count + offset + 1) * _stride > _destination.size()) {
+		throw std::out_of_range("More vertices written than were reserved.");
+	}
+	packVertex(components.data(), _layout, _destination.data() + (_count + offset) * _stride);
+}
+
+void VertexWriter::commit(const std::size_t count, const std::array<float, 3>& min, const std::array<float, 3>& max) {
+	if ((_count + count) * _stride > _destination.size()) {
+		throw std::out_of_range("More vertices written than were reserved.");
+	}
+	for (std::size_t c = 0; c < 3; ++c) {
+		_min[c] = _count == 0 ? min[c] : std::min(_min[c], min[c]);
+		_max[c] = _count == 0 ? max[c] : std::max(_max[c], max[c]);
+	}
+	_count += count;
+}
+
+std::size_t VertexWriter::getCount() const {
+	return _count;
+}
+
+std::array<float, 3> VertexWriter::getMin() const {
+	return _min;
+}
+
+std::array<float, 3> VertexWriter::getMax() const {
+	return _max;
+}
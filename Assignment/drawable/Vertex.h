@@ -1,5 +1,10 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <span>
+#include <vector>
+
 enum class AttributeSize {
 	VEC_1 = 1,
 	VEC_2 = 2,
@@ -7,7 +12,78 @@ enum class AttributeSize {
 	VEC_4 = 4
 };
 
+// How an attribute is stored on the GPU. Drawables always produce floats,
+// which get quantized into the storage type when the vertices are packed.
+enum class AttributeType {
+	FLOAT,				// 32-bit float per component
+	HALF_FLOAT,			// 16-bit float per component
+	UNSIGNED_SHORT,		// 16-bit unsigned normalized per component, [0; 1]
+	UNSIGNED_BYTE,		// 8-bit unsigned normalized per component, [0; 1]
+	INT_2_10_10_10_REV	// 10-bit signed normalized xyz in a single word, [-1; 1]
+};
+
 struct GenericAttribute {
 	const AttributeSize size;
 	const bool normalized;
+	const AttributeType type{ AttributeType::FLOAT };
+};
+
+// The number of bytes an attribute takes in a packed vertex, padded to 4 bytes.
+[[nodiscard]] std::size_t attributeBytes(const GenericAttribute& attribute);
+
+// The number of bytes a packed vertex takes.
+[[nodiscard]] std::size_t vertexStride(const std::vector<GenericAttribute>& layout);
+
+// The number of floats a vertex takes before packing.
+[[nodiscard]] std::size_t vertexComponents(const std::vector<GenericAttribute>& layout);
+
+// Quantizes interleaved float vertices into the storage types of the layout.
+[[nodiscard]] std::vector<std::byte> packVertices(const std::vector<float>& vertices, const std::vector<GenericAttribute>& layout);
+
+// Same as above, but writes into memory the caller provides, such as a mapped buffer region.
+// Returns the number of bytes written, the destination must hold at least that many.
+std::size_t packVertices(const std::vector<float>& vertices, const std::vector<GenericAttribute>& layout, std::span<std::byte> destination);
+
+// Quantizes a single vertex of interleaved floats into the storage types of the layout.
+void packVertex(const float* source, const std::vector<GenericAttribute>& layout, std::byte* output);
+
+// Reads a single attribute of a packed vertex back into floats, as many as the attribute has components.
+void unpackAttribute(const std::byte* input, const GenericAttribute& attribute, float* output);
+
+// Packs vertices one at a time into memory reserved for them up front, such as mapped upload memory.
+class VertexWriter {
+public:
+	VertexWriter(std::span<std::byte> destination, std::vector<GenericAttribute> layout);
+
+	// Packs the next vertex from its float components, in the order of the layout.
+	void write(std::span<const float> components);
+
+	// Packs a vertex into the slot that many places past the vertices written so far, touching neither the
+	// count nor the box, so separate threads can fill separate slots at once. commit then accounts for them.
+	void writeAt(std::size_t offset, std::span<const float> components) const;
+
+	// Counts the next count slots as written, their positions lying within the given box.
+	void commit(std::size_t count, const std::array<float, 3>& min, const std::array<float, 3>& max);
+
+	[[nodiscard]] std::size_t getCount() const;
+
+	// The corners of the box around the positions written so far, the first three components of every vertex.
+	[[nodiscard]] std::array<float, 3> getMin() const;
+
+	[[nodiscard]] std::array<float, 3> getMax() const;
+
+private:
+	const std::span<std::byte> _destination;
+
+	const std::vector<GenericAttribute> _layout;
+
+	const std::size_t _stride;
+
+	const std::size_t _components;
+
+	std::size_t _count{ 0 };
+
+	std::array<float, 3> _min{};
+
+	std::array<float, 3> _max{};
 };
@@ -1,9 +1,27 @@
+#include <format>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
 #include "Context.h"
 #include "Engine.h"
 
+#include "assignment/HeightExpression.h"
 #include "assignment/PackageOne.h"
 
-int main() {
+int main(const int argc, char* argv[]) {
+	// a height expression on the command line, such as "sin(x + t) * cos(y)", replaces the built-in surface,
+	// compiled before anything opens so a typo in it only costs an error message
+	auto expression = std::optional<HeightExpression>{};
+	if (argc > 1) {
+		try {
+			expression.emplace(HeightExpression::compile(argv[1]));
+		} catch (const std::invalid_argument& e) {
+			std::cerr << e.what() << '\n';
+			return 1;
+		}
+	}
+
 	auto context = Context::create("PackageOne<1952092>");
 
 	context->bindKey(Context::Key::ESC, [&context]{ context->setClose(true); });
@@ -11,7 +29,9 @@ int main() {
 	context->bindKey(Context::Key::F, [] { Engine::setPolygonMode(Engine::PolygonMode::FILL); });
 
 	auto engine = Engine::create(*context);
-	engine->setClearColor(0.09804f, 0.14118f, 0.15686f, 1.0f);
+
+	const auto renderer = engine->createRenderer();
+	renderer->setClearOptions({ .clearColor = { 0.09804f, 0.14118f, 0.15686f, 1.0f } });
 
 	const auto camera = engine->createCamera(EntityManager::get()->create(), context->getInitialRatio());
 
@@ -35,15 +55,46 @@ int main() {
 	const auto bakedStripSphere = BakedStripSphere();
 	const auto bakedCylinder = BakedCylinder();
 	const auto bakedPyramid = BakedPyramid();
-	const auto bakedMesh = BakedMesh::Builder([](auto x, auto y) { return std::sin(x) + std::cos(y); })
+	const auto bakedMesh = (expression
+		? BakedMesh::Builder(*expression)
+		: BakedMesh::Builder([](auto x, auto y, auto t) { return std::sin(x + t) + std::cos(y - t); }))
 		.halfExtentX(5.0f)
 		.halfExtentY(5.0f)
 		.segments(100)
 		.build();
 
-	const auto renderable = engine->loadMesh(bakedMesh);
+	// the static mesh is written straight into upload memory, trading the vertex cache reordering
+	// (an ACMR of about 1.0 for the row strips against about 0.68 once optimized) for a load that
+	// never holds a second copy of the grid
+	const auto renderable = bakedMesh.isAnimated()
+		? engine->createDynamicMesh(bakedMesh)
+		: engine->loadMesh(bakedMesh, Engine::DIRECT_LOAD_OPTIONS);
+	const auto& stats = engine->getMeshStats(renderable);
+	if (stats.acmrBefore > 0.0f) {
+		std::cout << std::format(
+			"Mesh loaded: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}\n",
+			stats.acmrBefore, stats.acmrAfter, stats.atvrBefore, stats.atvrAfter
+		);
+	} else {
+		std::cout << "Mesh loaded: written directly, not optimized\n";
+	}
 
-	context->loop([&] { engine->render(renderable, *camera); });
+	const auto scene = engine->createScene();
+	scene->addEntity(EntityManager::get()->create(), renderable);
+
+	const auto view = engine->createView();
+	view->setScene(scene);
+	view->setCamera(camera);
+
+	context->loop([&] {
+		if (bakedMesh.isAnimated()) {
+			engine->updateDynamicMesh(renderable, [&](const auto vertices) {
+				return bakedMesh.animate(context->getCurrentTime(), vertices);
+			});
+		}
+		engine->updateTransforms();
+		renderer->render(view);
+	});
 
 	engine->destroyCamera(camera->getEntity());
 	engine->destroy();
@@ -0,0 +1,23 @@
+#version 440 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+
+// per instance, matches Engine::INSTANCE_TRANSFORM_LOCATION and Engine::INSTANCE_COLOR_LOCATION
+layout (location = 8) in mat4 aInstanceTransform;
+layout (location = 12) in vec4 aInstanceColor;
+
+out vec4 vertexColor;
+
+layout (std140, binding = 0) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+};
+
+uniform mat4 model;
+
+void main() {
+	gl_Position = viewProjection * model * aInstanceTransform * vec4(aPos, 1.0f);
+	vertexColor = vec4(aColor, 1.0f) * aInstanceColor;
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#version 440 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+layout (location = 2) in vec2 aMorph;	// the height on the next coarser level, and the distance it takes over at
+
+out vec4 vertexColor;
+
+layout (std140, binding = 0) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+};
+
+uniform mat4 model;
+
+// the share of the range after which a chunk starts morphing, matches Terrain::MORPH_START
+const float MORPH_START = 0.8f;
+
+void main() {
+	// the eye is the translation of the inverse view, which is a rigid transform
+	vec3 eye = -transpose(mat3(view)) * view[3].xyz;
+	float distance = length((model * vec4(aPos, 1.0f)).xyz - eye);
+
+	// slide the height into the coarser level, so the chunk matches it by the time the level switches
+	float morph = clamp((distance / aMorph.y - MORPH_START) / (1.0f - MORPH_START), 0.0f, 1.0f);
+	vec3 position = vec3(aPos.xy, mix(aPos.z, aMorph.x, morph));
+
+	gl_Position = viewProjection * model * vec4(position, 1.0f);
+	vertexColor = vec4(aColor, 1.0f);
+}
\ No newline at end of file
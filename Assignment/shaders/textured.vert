@@ -5,11 +5,15 @@ layout (location = 1) in vec2 aTexCoord;
 
 out vec2 vertTexCoord;
 
+layout (std140, binding = 0) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main() {
-	gl_Position = projection * view * model * vec4(aPos, 1.0f);
+	gl_Position = viewProjection * model * vec4(aPos, 1.0f);
 	vertTexCoord = aTexCoord;
 }
\ No newline at end of file